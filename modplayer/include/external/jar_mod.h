@@ -63,6 +63,13 @@
 //
 // - "Load" a MOD from file, context must already be initialized.
 //   Return size of file in bytes.
+//   On Linux and macOS the file is mapped read-only instead of read to the heap, define JAR_MOD_NO_MMAP to disable.
+// -------------------------------------------
+// mulong jar_mod_load_shared(jar_mod_context_t * modctx, jar_mod_context_t * source)
+//
+// - "Load" the MOD of another context, context must already be initialized.
+//   The module data is shared, it is freed by the last context unloading it. Not thread safe.
+//   Return size of the module in bytes.
 // -------------------------------------------
 // void jar_mod_fillbuffer( jar_mod_context_t * modctx, short * outbuffer, unsigned long nbsample, jar_mod_tracker_buffer_state * trkbuf )
 //
@@ -101,6 +108,7 @@ typedef unsigned long mulong;
 
 #define NUMMAXCHANNELS 32
 #define MAXNOTES 12*12
+#define SPAN_SAMPLES 256
 #define DEFAULT_SAMPLE_RATE 48000
 //
 // MOD file structures
@@ -182,11 +190,11 @@ typedef struct {
     mulong  patternticks;
     mulong  patterntickse;
     mulong  patternticksaim;
-    mulong  sampleticksconst;
+    mulong  sampleticksconst; // Sample step numerator, 10 bits fixed point
     mulong  samplenb;
+    float   pitch;
     channel channels[NUMMAXCHANNELS];
     muint   number_of_channels;
-    muint   fullperiod[MAXNOTES * 8];
     muint   mod_loaded;
     mint    last_r_sample;
     mint    last_l_sample;
@@ -197,6 +205,8 @@ typedef struct {
     
     muchar *modfile; // the raw mod file
     mulong  modfilesize;
+    muint   modfilemapped; // modfile is a file mapping, not a heap copy
+    mulong *modfileusers; // Contexts sharing modfile, NULL while it isn't shared
     muint   loopcount;
 } jar_mod_context_t;
 
@@ -248,9 +258,16 @@ bool   jar_mod_setcfg(jar_mod_context_t * modctx, int samplerate, int bits, int
 void   jar_mod_fillbuffer(jar_mod_context_t * modctx, short * outbuffer, unsigned long nbsample, jar_mod_tracker_buffer_state * trkbuf);
 void   jar_mod_unload(jar_mod_context_t * modctx);
 mulong jar_mod_load_file(jar_mod_context_t * modctx, const char* filename);
+mulong jar_mod_load_memory(jar_mod_context_t * modctx, const void* data, mulong size);
+mulong jar_mod_load_shared(jar_mod_context_t * modctx, jar_mod_context_t * source);
 mulong jar_mod_current_samples(jar_mod_context_t * modctx);
 mulong jar_mod_max_samples(jar_mod_context_t * modctx);
 void   jar_mod_seek_start(jar_mod_context_t * ctx);
+void   jar_mod_set_pitch(jar_mod_context_t * modctx, float pitch);
+void   jar_mod_skip_samples(jar_mod_context_t * modctx, unsigned long nbsample);
+mulong jar_mod_get_state_size(jar_mod_context_t * modctx);
+void   jar_mod_save_state(jar_mod_context_t * modctx, void * state);
+bool   jar_mod_load_state(jar_mod_context_t * modctx, const void * state);
 
 #ifdef __cplusplus
 }
@@ -262,6 +279,17 @@ void   jar_mod_seek_start(jar_mod_context_t * ctx);
 //-------------------------------------------------------------------------------
 #ifdef JAR_MOD_IMPLEMENTATION
 
+// Module files are mapped on POSIX targets: samples and patterns are played straight from the page cache
+// NOTE: Android fopen() reads application assets, those can't be mapped
+#if !defined(JAR_MOD_NO_MMAP) && ((defined(__linux__) && !defined(__ANDROID__)) || defined(__APPLE__))
+#define JAR_MOD_MMAP
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 // Effects list
 #define EFFECT_ARPEGGIO              0x0 // Supported
 #define EFFECT_PORTAMENTO_UP         0x1 // Supported
@@ -316,6 +344,83 @@ static const short periodtable[]=
        13,    13,    12,    11,    11,    10,     9,     9,     8,     8,     7,     7
 };
 
+// Period table with the 8 finetune steps between each note, shared by all contexts.
+static const muint fullperiod[FULL_PERIOD_TABLE_LENGTH]=
+{
+    27392, 27200, 27008, 26816, 26624, 26432, 26240, 26048, 25856, 25672, 25488, 25304, 25120, 24936, 24752, 24568,
+    24384, 24216, 24048, 23880, 23712, 23544, 23376, 23208, 23040, 22872, 22704, 22536, 22368, 22200, 22032, 21864,
+    21696, 21544, 21392, 21240, 21088, 20936, 20784, 20632, 20480, 20336, 20192, 20048, 19904, 19760, 19616, 19472,
+    19328, 19192, 19056, 18920, 18784, 18648, 18512, 18376, 18240, 18112, 17984, 17856, 17728, 17600, 17472, 17344,
+    17216, 17096, 16976, 16856, 16736, 16616, 16496, 16376, 16256, 16144, 16032, 15920, 15808, 15696, 15584, 15472,
+    15360, 15252, 15144, 15036, 14928, 14820, 14712, 14604, 14496, 14396, 14296, 14196, 14096, 13996, 13896, 13796,
+    13696, 13600, 13504, 13408, 13312, 13216, 13120, 13024, 12928, 12836, 12744, 12652, 12560, 12468, 12376, 12284,
+    12192, 12108, 12024, 11940, 11856, 11772, 11688, 11604, 11520, 11436, 11352, 11268, 11184, 11100, 11016, 10932,
+    10848, 10772, 10696, 10620, 10544, 10468, 10392, 10316, 10240, 10168, 10096, 10024,  9952,  9880,  9808,  9736,
+     9664,  9596,  9528,  9460,  9392,  9324,  9256,  9188,  9120,  9056,  8992,  8928,  8864,  8800,  8736,  8672,
+     8606,  8547,  8488,  8429,  8370,  8311,  8252,  8193,  8128,  8072,  8016,  7960,  7904,  7848,  7792,  7736,
+     7680,  7626,  7572,  7518,  7464,  7410,  7356,  7302,  7248,  7198,  7148,  7098,  7048,  6998,  6948,  6898,
+     6848,  6800,  6752,  6704,  6656,  6608,  6560,  6512,  6464,  6418,  6372,  6326,  6280,  6234,  6188,  6142,
+     6096,  6054,  6012,  5970,  5928,  5886,  5844,  5802,  5760,  5718,  5676,  5634,  5592,  5550,  5508,  5466,
+     5424,  5386,  5348,  5310,  5272,  5234,  5196,  5158,  5120,  5084,  5048,  5012,  4976,  4940,  4904,  4868,
+     4832,  4798,  4764,  4730,  4696,  4662,  4628,  4594,  4560,  4528,  4496,  4464,  4432,  4400,  4368,  4336,
+     4304,  4274,  4244,  4214,  4184,  4154,  4124,  4094,  4064,  4036,  4008,  3980,  3952,  3924,  3896,  3868,
+     3840,  3813,  3786,  3759,  3732,  3705,  3678,  3651,  3624,  3599,  3574,  3549,  3524,  3499,  3474,  3449,
+     3424,  3400,  3376,  3352,  3328,  3304,  3280,  3256,  3232,  3209,  3186,  3163,  3140,  3117,  3094,  3071,
+     3048,  3027,  3006,  2985,  2964,  2943,  2922,  2901,  2880,  2859,  2838,  2817,  2796,  2775,  2754,  2733,
+     2712,  2693,  2674,  2655,  2636,  2617,  2598,  2579,  2560,  2542,  2524,  2506,  2488,  2470,  2452,  2434,
+     2416,  2399,  2382,  2365,  2348,  2331,  2314,  2297,  2280,  2264,  2248,  2232,  2216,  2200,  2184,  2168,
+     2152,  2137,  2122,  2107,  2092,  2077,  2062,  2047,  2032,  2018,  2004,  1990,  1976,  1962,  1948,  1934,
+     1920,  1907,  1894,  1881,  1868,  1855,  1842,  1829,  1812,  1800,  1788,  1776,  1764,  1752,  1740,  1728,
+     1712,  1700,  1688,  1676,  1664,  1652,  1640,  1628,  1616,  1605,  1594,  1583,  1572,  1561,  1550,  1539,
+     1524,  1514,  1504,  1494,  1484,  1474,  1464,  1454,  1440,  1430,  1420,  1410,  1400,  1390,  1380,  1370,
+     1356,  1347,  1338,  1329,  1320,  1311,  1302,  1293,  1280,  1271,  1262,  1253,  1244,  1235,  1226,  1217,
+     1208,  1200,  1192,  1184,  1176,  1168,  1160,  1152,  1140,  1132,  1124,  1116,  1108,  1100,  1092,  1084,
+     1076,  1069,  1062,  1055,  1048,  1041,  1034,  1027,  1016,  1009,  1002,   995,   988,   981,   974,   967,
+      960,   954,   948,   942,   936,   930,   924,   918,   906,   900,   894,   888,   882,   876,   870,   864,
+      856,   850,   844,   838,   832,   826,   820,   814,   808,   803,   798,   793,   788,   783,   778,   773,
+      762,   757,   752,   747,   742,   737,   732,   727,   720,   715,   710,   705,   700,   695,   690,   685,
+      678,   674,   670,   666,   662,   658,   654,   650,   640,   636,   632,   628,   624,   620,   616,   612,
+      604,   600,   596,   592,   588,   584,   580,   576,   570,   566,   562,   558,   554,   550,   546,   542,
+      538,   535,   532,   529,   526,   523,   520,   517,   508,   505,   502,   499,   496,   493,   490,   487,
+      480,   477,   474,   471,   468,   465,   462,   459,   453,   450,   447,   444,   441,   438,   435,   432,
+      428,   425,   422,   419,   416,   413,   410,   407,   404,   402,   400,   398,   396,   394,   392,   390,
+      381,   379,   377,   375,   373,   371,   369,   367,   360,   358,   356,   354,   352,   350,   348,   346,
+      339,   337,   335,   333,   331,   329,   327,   325,   320,   318,   316,   314,   312,   310,   308,   306,
+      302,   300,   298,   296,   294,   292,   290,   288,   285,   283,   281,   279,   277,   275,   273,   271,
+      269,   268,   267,   266,   265,   264,   263,   262,   254,   253,   252,   251,   250,   249,   248,   247,
+      240,   239,   238,   237,   236,   235,   234,   233,   226,   225,   224,   223,   222,   221,   220,   219,
+      214,   213,   212,   211,   210,   209,   208,   207,   202,   201,   200,   199,   198,   197,   196,   195,
+      190,   189,   188,   187,   186,   185,   184,   183,   180,   179,   178,   177,   176,   175,   174,   173,
+      170,   169,   168,   167,   166,   165,   164,   163,   160,   159,   158,   157,   156,   155,   154,   153,
+      151,   150,   149,   148,   147,   146,   145,   144,   143,   142,   141,   140,   139,   138,   137,   136,
+      135,   134,   133,   132,   131,   130,   129,   128,   127,   127,   127,   127,   127,   127,   127,   127,
+      120,   120,   120,   120,   120,   120,   120,   120,   113,   113,   113,   113,   113,   113,   113,   113,
+      107,   107,   107,   107,   107,   107,   107,   107,   101,   101,   101,   101,   101,   101,   101,   101,
+       95,    95,    95,    95,    95,    95,    95,    95,    90,    90,    90,    90,    90,    90,    90,    90,
+       85,    85,    85,    85,    85,    85,    85,    85,    80,    80,    80,    80,    80,    80,    80,    80,
+       75,    75,    75,    75,    75,    75,    75,    75,    71,    71,    71,    71,    71,    71,    71,    71,
+       67,    67,    67,    67,    67,    67,    67,    67,    63,    63,    63,    63,    63,    63,    63,    63,
+       60,    60,    60,    60,    60,    60,    60,    60,    56,    56,    56,    56,    56,    56,    56,    56,
+       53,    53,    53,    53,    53,    53,    53,    53,    50,    50,    50,    50,    50,    50,    50,    50,
+       47,    47,    47,    47,    47,    47,    47,    47,    45,    45,    45,    45,    45,    45,    45,    45,
+       42,    42,    42,    42,    42,    42,    42,    42,    40,    40,    40,    40,    40,    40,    40,    40,
+       37,    37,    37,    37,    37,    37,    37,    37,    35,    35,    35,    35,    35,    35,    35,    35,
+       33,    33,    33,    33,    33,    33,    33,    33,    31,    31,    31,    31,    31,    31,    31,    31,
+       30,    30,    30,    30,    30,    30,    30,    30,    28,    28,    28,    28,    28,    28,    28,    28,
+       27,    27,    27,    27,    27,    27,    27,    27,    25,    25,    25,    25,    25,    25,    25,    25,
+       24,    24,    24,    24,    24,    24,    24,    24,    22,    22,    22,    22,    22,    22,    22,    22,
+       21,    21,    21,    21,    21,    21,    21,    21,    20,    20,    20,    20,    20,    20,    20,    20,
+       19,    19,    19,    19,    19,    19,    19,    19,    18,    18,    18,    18,    18,    18,    18,    18,
+       17,    17,    17,    17,    17,    17,    17,    17,    16,    16,    16,    16,    16,    16,    16,    16,
+       15,    15,    15,    15,    15,    15,    15,    15,    14,    14,    14,    14,    14,    14,    14,    14,
+       13,    13,    13,    13,    13,    13,    13,    13,    13,    13,    13,    13,    13,    13,    13,    13,
+       12,    12,    12,    12,    12,    12,    12,    12,    11,    11,    11,    11,    11,    11,    11,    11,
+       11,    11,    11,    11,    11,    11,    11,    11,    10,    10,    10,    10,    10,    10,    10,    10,
+        9,     9,     9,     9,     9,     9,     9,     9,     9,     9,     9,     9,     9,     9,     9,     9,
+        8,     8,     8,     8,     8,     8,     8,     8,     8,     8,     8,     8,     8,     8,     8,     8,
+        7,     7,     7,     7,     7,     7,     7,     7,     0,     0,     0,     0,     0,     0,     0,     0
+};
+
 static const short sintable[]={
       0,  24,  49,  74,  97, 120, 141,161,
     180, 197, 212, 224, 235, 244, 250,253,
@@ -398,13 +503,24 @@ static int memcompare( unsigned char * buf1, unsigned char * buf2, unsigned int
     return 1;
 }
 
-static int getnote( jar_mod_context_t * mod, unsigned short period, int finetune )
+// Ticks are counted in output samples, a higher pitch shortens them like a lower playrate would
+static mulong jar_mod_tickrate( jar_mod_context_t * mod )
+{
+    return (mulong)( (float)mod->playrate / mod->pitch );
+}
+
+static mulong jar_mod_sampleticks( jar_mod_context_t * mod )
+{
+    return (mulong)( ( 3546894.0 * 1024.0 * mod->pitch ) / mod->playrate ); //8448*428/playrate, 10 bits fixed point
+}
+
+static int getnote( unsigned short period )
 {
     int i;
 
     for(i = 0; i < FULL_PERIOD_TABLE_LENGTH; i++)
     {
-        if(period >= mod->fullperiod[i])
+        if(period >= fullperiod[i])
         {
             return i;
         }
@@ -466,11 +582,11 @@ static void worknote( note * nptr, channel * cptr, char t, jar_mod_context_t * m
             {
                 if( cptr->finetune <= 7 )
                 {
-                    period = mod->fullperiod[getnote(mod,period,0) + cptr->finetune];
+                    period = fullperiod[getnote(period) + cptr->finetune];
                 }
                 else
                 {
-                    period = mod->fullperiod[getnote(mod,period,0) - (16 - (cptr->finetune)) ];
+                    period = fullperiod[getnote(period) - (16 - (cptr->finetune)) ];
                 }
             }
 
@@ -503,7 +619,7 @@ static void worknote( note * nptr, channel * cptr, char t, jar_mod_context_t * m
 
                 cptr->ArpIndex = 0;
 
-                curnote = getnote(mod,cptr->period,cptr->finetune);
+                curnote = getnote(cptr->period);
 
                 cptr->Arpperiods[0] = cptr->period;
 
@@ -511,13 +627,13 @@ static void worknote( note * nptr, channel * cptr, char t, jar_mod_context_t * m
                 if( arpnote >= FULL_PERIOD_TABLE_LENGTH )
                     arpnote = FULL_PERIOD_TABLE_LENGTH - 1;
 
-                cptr->Arpperiods[1] = mod->fullperiod[arpnote];
+                cptr->Arpperiods[1] = fullperiod[arpnote];
 
                 arpnote = curnote + (((cptr->parameffect)&0xF)*8);
                 if( arpnote >= FULL_PERIOD_TABLE_LENGTH )
                     arpnote = FULL_PERIOD_TABLE_LENGTH - 1;
 
-                cptr->Arpperiods[2] = mod->fullperiod[arpnote];
+                cptr->Arpperiods[2] = fullperiod[arpnote];
             }
         break;
 
@@ -872,7 +988,7 @@ static void worknote( note * nptr, channel * cptr, char t, jar_mod_context_t * m
                 if( effect&0xFF )
                 {
                     mod->song.speed = effect&0xFF;
-                    mod->patternticksaim = (long)mod->song.speed * ((mod->playrate * 5 ) / (((long)2 * (long)mod->bpm)));
+                    mod->patternticksaim = (long)mod->song.speed * ((jar_mod_tickrate(mod) * 5 ) / (((long)2 * (long)mod->bpm)));
                 }
             }
 
@@ -880,7 +996,7 @@ static void worknote( note * nptr, channel * cptr, char t, jar_mod_context_t * m
             {
                 ///  HZ = 2 * BPM / 5
                 mod->bpm = effect&0xFF;
-                mod->patternticksaim = (long)mod->song.speed * ((mod->playrate * 5 ) / (((long)2 * (long)mod->bpm)));
+                mod->patternticksaim = (long)mod->song.speed * ((jar_mod_tickrate(mod) * 5 ) / (((long)2 * (long)mod->bpm)));
             }
 
         break;
@@ -1053,25 +1169,16 @@ static void workeffect( note * nptr, channel * cptr )
 ///////////////////////////////////////////////////////////////////////////////////
 bool jar_mod_init(jar_mod_context_t * modctx)
 {
-    muint i,j;
-
     if( modctx )
     {
         memclear(modctx, 0, sizeof(jar_mod_context_t));
         modctx->playrate = DEFAULT_SAMPLE_RATE;
+        modctx->pitch = 1.0f;
         modctx->stereo = 1;
         modctx->stereo_separation = 1;
         modctx->bits = 16;
         modctx->filter = 1;
 
-        for(i=0; i < PERIOD_TABLE_LENGTH - 1; i++)
-        {
-            for(j=0; j < 8; j++)
-            {
-                modctx->fullperiod[(i*8) + j] = periodtable[i] - ((( periodtable[i] - periodtable[i+1] ) / 8) * j);
-            }
-        }
-
         return 1;
     }
 
@@ -1123,6 +1230,9 @@ static bool jar_mod_load( jar_mod_context_t * modctx, void * mod_data, int mod_d
     
     
 
+    if( mod_data_size < 1084 )
+        return 0; // Shorter than the module header
+
     if(modmemory)
     {
         if( modctx )
@@ -1209,10 +1319,10 @@ static bool jar_mod_load( jar_mod_context_t * modctx, void * mod_data, int mod_d
             modctx->bpm = 125;
             modctx->samplenb = 0;
 
-            modctx->patternticks = (((long)modctx->song.speed * modctx->playrate * 5)/ (2 * modctx->bpm)) + 1;
-            modctx->patternticksaim = ((long)modctx->song.speed * modctx->playrate * 5) / (2 * modctx->bpm);
+            modctx->patternticks = (((long)modctx->song.speed * jar_mod_tickrate(modctx) * 5)/ (2 * modctx->bpm)) + 1;
+            modctx->patternticksaim = ((long)modctx->song.speed * jar_mod_tickrate(modctx) * 5) / (2 * modctx->bpm);
 
-            modctx->sampleticksconst = 3546894UL / modctx->playrate; //8448*428/playrate;
+            modctx->sampleticksconst = jar_mod_sampleticks(modctx);
 
             for(i=0; i < modctx->number_of_channels; i++)
             {
@@ -1229,15 +1339,156 @@ static bool jar_mod_load( jar_mod_context_t * modctx, void * mod_data, int mod_d
     return 0;
 }
 
+// Start the next row, or the next repeat of a delayed row. Only sequencer and channel states are touched, no sample data
+static void jar_mod_next_row( jar_mod_context_t * modctx )
+{
+    unsigned char c;
+    note    *nptr;
+    channel *cptr;
+
+    if( !modctx->patterndelay )
+    {
+        nptr = modctx->patterndata[modctx->song.patterntable[modctx->tablepos]];
+        nptr = nptr + modctx->patternpos;
+        cptr = modctx->channels;
+
+        modctx->patternticks = 0;
+        modctx->patterntickse = 0;
+
+        for(c=0;c<modctx->number_of_channels;c++)
+        {
+            worknote((note*)(nptr+c), (channel*)(cptr+c),(char)(c+1),modctx);
+        }
+
+        if( !modctx->jump_loop_effect )
+            modctx->patternpos += modctx->number_of_channels;
+        else
+            modctx->jump_loop_effect = 0;
+
+        if( modctx->patternpos == 64*modctx->number_of_channels )
+        {
+            modctx->tablepos++;
+            modctx->patternpos = 0;
+            if(modctx->tablepos >= modctx->song.length)
+            {
+                modctx->tablepos = 0;
+                modctx->loopcount++; // count next loop
+            }
+        }
+    }
+    else
+    {
+        modctx->patterndelay--;
+        modctx->patternticks = 0;
+        modctx->patterntickse = 0;
+    }
+}
+
+// Mix nb samples of a channel at a constant step, wraps the position like the tracker did sample by sample
+static void mixchannel( channel * cptr, mulong step, int * mix, unsigned long nb )
+{
+    unsigned long i;
+    mulong pos, end, start;
+    char * data;
+    int vol;
+
+    pos = cptr->samppos;
+    data = cptr->sampdata;
+    vol = cptr->volume;
+
+    if( cptr->replen<=2 )
+    {
+        end = ((unsigned long)cptr->length)<<10;
+
+        for(i = 0; i < nb; i++)
+        {
+            pos += step;
+            if( pos >= end )
+                break;
+
+            if( data )
+                mix[i] += data[pos>>10] * vol;
+        }
+
+        if( i < nb )
+        {
+            // Sample end, the channel then stays on the first sample point
+            cptr->length = 0;
+            cptr->reppnt = 0;
+            pos = 0;
+
+            if( data )
+            {
+                for(; i < nb; i++)
+                    mix[i] += data[0] * vol;
+            }
+        }
+    }
+    else
+    {
+        end = ((unsigned long)(cptr->replen+cptr->reppnt))<<10;
+        start = ((unsigned long)(cptr->reppnt))<<10;
+
+        for(i = 0; i < nb; i++)
+        {
+            pos += step;
+            if( pos >= end )
+                pos = start + (pos % end);
+
+            if( data )
+                mix[i] += data[pos>>10] * vol;
+        }
+    }
+
+    cptr->samppos = pos;
+}
+
+// Record the player status of the buffer sample index in the tracker buffer
+static void jar_mod_trackstate( jar_mod_context_t * modctx, jar_mod_tracker_buffer_state * trkbuf, unsigned long index )
+{
+    unsigned long j;
+    channel *cptr;
+    tracker_state *state;
+
+    if( trkbuf->nb_of_state < trkbuf->nb_max_of_state )
+    {
+        state = &trkbuf->track_state_buf[trkbuf->nb_of_state];
+        memclear(state, 0, sizeof(tracker_state));
+
+        for(j =0, cptr = modctx->channels; j < modctx->number_of_channels ; j++, cptr++)
+        {
+            if( cptr->period != 0 )
+            {
+                state->number_of_tracks = modctx->number_of_channels;
+                state->buf_index = index;
+                state->cur_pattern = modctx->song.patterntable[modctx->tablepos];
+                state->cur_pattern_pos = modctx->patternpos / modctx->number_of_channels;
+                state->cur_pattern_table_pos = modctx->tablepos;
+                state->bpm = modctx->bpm;
+                state->speed = modctx->song.speed;
+                state->tracks[j].cur_effect = cptr->effect_code;
+                state->tracks[j].cur_parameffect = cptr->parameffect;
+                state->tracks[j].cur_period = (short)(cptr->period - cptr->decalperiod - cptr->vibraperiod);
+                state->tracks[j].cur_volume = cptr->volume;
+                state->tracks[j].instrument_number = (unsigned char)cptr->sampnum;
+            }
+        }
+
+        trkbuf->nb_of_state++;
+    }
+}
+
 void jar_mod_fillbuffer( jar_mod_context_t * modctx, short * outbuffer, unsigned long nbsample, jar_mod_tracker_buffer_state * trkbuf )
 {
     unsigned long i, j;
-    unsigned long k;
+    unsigned long k, run;
     unsigned char c;
     unsigned int state_remaining_steps;
     int l,r;
     int ll,lr;
     int tl,tr;
+    int mixl[SPAN_SAMPLES], mixr[SPAN_SAMPLES];
+    mulong step, aim;
     short finalperiod;
     note    *nptr;
     channel *cptr;
@@ -1263,48 +1514,13 @@ void jar_mod_fillbuffer( jar_mod_context_t * modctx, short * outbuffer, unsigned
             ll = modctx->last_l_sample;
             lr = modctx->last_r_sample;
 
-            for (i = 0; i < nbsample; i++)
+            i = 0;
+            while( i < nbsample )
             {
                 //---------------------------------------
                 if( modctx->patternticks++ > modctx->patternticksaim )
                 {
-                    if( !modctx->patterndelay )
-                    {
-                        nptr = modctx->patterndata[modctx->song.patterntable[modctx->tablepos]];
-                        nptr = nptr + modctx->patternpos;
-                        cptr = modctx->channels;
-
-                        modctx->patternticks = 0;
-                        modctx->patterntickse = 0;
-
-                        for(c=0;c<modctx->number_of_channels;c++)
-                        {
-                            worknote((note*)(nptr+c), (channel*)(cptr+c),(char)(c+1),modctx);
-                        }
-
-                        if( !modctx->jump_loop_effect )
-                            modctx->patternpos += modctx->number_of_channels;
-                        else
-                            modctx->jump_loop_effect = 0;
-
-                        if( modctx->patternpos == 64*modctx->number_of_channels )
-                        {
-                            modctx->tablepos++;
-                            modctx->patternpos = 0;
-                            if(modctx->tablepos >= modctx->song.length)
-                            {
-                                modctx->tablepos = 0;
-                                modctx->loopcount++; // count next loop
-                            }
-                        }
-                    }
-                    else
-                    {
-                        modctx->patterndelay--;
-                        modctx->patternticks = 0;
-                        modctx->patterntickse = 0;
-                    }
-
+                    jar_mod_next_row(modctx);
                 }
 
                 if( modctx->patterntickse++ > (modctx->patternticksaim/modctx->song.speed) )
@@ -1321,127 +1537,95 @@ void jar_mod_fillbuffer( jar_mod_context_t * modctx, short * outbuffer, unsigned
                     modctx->patterntickse = 0;
                 }
 
+                // Samples until the next row or effect tick, periods can't change in between
+                run = ( modctx->patternticks <= modctx->patternticksaim + 1 ) ? modctx->patternticksaim + 2 - modctx->patternticks : 1;
+                aim = modctx->patternticksaim/modctx->song.speed;
+                if( modctx->patterntickse > aim + 1 )
+                    run = 1;
+                else if( aim + 2 - modctx->patterntickse < run )
+                    run = aim + 2 - modctx->patterntickse;
+                if( run > nbsample - i )
+                    run = nbsample - i;
+                if( run > SPAN_SAMPLES )
+                    run = SPAN_SAMPLES;
+
                 //---------------------------------------
 
-                if( trkbuf && !state_remaining_steps )
+                if( trkbuf )
                 {
-                    if( trkbuf->nb_of_state < trkbuf->nb_max_of_state )
+                    k = 0;
+                    while( k < run )
                     {
-                        memclear(&trkbuf->track_state_buf[trkbuf->nb_of_state], 0, sizeof(tracker_state));
+                        if( !state_remaining_steps )
+                        {
+                            jar_mod_trackstate(modctx, trkbuf, i + k);
+                            state_remaining_steps = trkbuf->sample_step;
+                            k++;
+                        }
+                        else
+                        {
+                            step = ( state_remaining_steps < run - k ) ? state_remaining_steps : run - k;
+                            state_remaining_steps -= step;
+                            k += step;
+                        }
                     }
                 }
 
-                l=0;
-                r=0;
+                memclear(mixl, 0, run * sizeof(int));
+                memclear(mixr, 0, run * sizeof(int));
 
                 for(j =0, cptr = modctx->channels; j < modctx->number_of_channels ; j++, cptr++)
                 {
                     if( cptr->period != 0 )
                     {
                         finalperiod = cptr->period - cptr->decalperiod - cptr->vibraperiod;
-                        if( finalperiod )
-                        {
-                            cptr->samppos += ( (modctx->sampleticksconst<<10) / finalperiod );
-                        }
-
-                        cptr->ticks++;
+                        step = finalperiod ? ( modctx->sampleticksconst / finalperiod ) : 0;
 
-                        if( cptr->replen<=2 )
-                        {
-                            if( (cptr->samppos>>10) >= (cptr->length) )
-                            {
-                                cptr->length = 0;
-                                cptr->reppnt = 0;
+                        cptr->ticks += run;
 
-                                if( cptr->length )
-                                    cptr->samppos = cptr->samppos % (((unsigned long)cptr->length)<<10);
-                                else
-                                    cptr->samppos = 0;
-                            }
-                        }
-                        else
-                        {
-                            if( (cptr->samppos>>10) >= (unsigned long)(cptr->replen+cptr->reppnt) )
-                            {
-                                cptr->samppos = ((unsigned long)(cptr->reppnt)<<10) + (cptr->samppos % ((unsigned long)(cptr->replen+cptr->reppnt)<<10));
-                            }
-                        }
-
-                        k = cptr->samppos >> 10;
-
-                        if( cptr->sampdata!=0 && ( ((j&3)==1) || ((j&3)==2) ) )
-                        {
-                            r += ( cptr->sampdata[k] *  cptr->volume );
-                        }
-
-                        if( cptr->sampdata!=0 && ( ((j&3)==0) || ((j&3)==3) ) )
-                        {
-                            l += ( cptr->sampdata[k] *  cptr->volume );
-                        }
-
-                        if( trkbuf && !state_remaining_steps )
-                        {
-                            if( trkbuf->nb_of_state < trkbuf->nb_max_of_state )
-                            {
-                                trkbuf->track_state_buf[trkbuf->nb_of_state].number_of_tracks = modctx->number_of_channels;
-                                trkbuf->track_state_buf[trkbuf->nb_of_state].buf_index = i;
-                                trkbuf->track_state_buf[trkbuf->nb_of_state].cur_pattern = modctx->song.patterntable[modctx->tablepos];
-                                trkbuf->track_state_buf[trkbuf->nb_of_state].cur_pattern_pos = modctx->patternpos / modctx->number_of_channels;
-                                trkbuf->track_state_buf[trkbuf->nb_of_state].cur_pattern_table_pos = modctx->tablepos;
-                                trkbuf->track_state_buf[trkbuf->nb_of_state].bpm = modctx->bpm;
-                                trkbuf->track_state_buf[trkbuf->nb_of_state].speed = modctx->song.speed;
-                                trkbuf->track_state_buf[trkbuf->nb_of_state].tracks[j].cur_effect = cptr->effect_code;
-                                trkbuf->track_state_buf[trkbuf->nb_of_state].tracks[j].cur_parameffect = cptr->parameffect;
-                                trkbuf->track_state_buf[trkbuf->nb_of_state].tracks[j].cur_period = finalperiod;
-                                trkbuf->track_state_buf[trkbuf->nb_of_state].tracks[j].cur_volume = cptr->volume;
-                                trkbuf->track_state_buf[trkbuf->nb_of_state].tracks[j].instrument_number = (unsigned char)cptr->sampnum;
-                            }
-                        }
+                        mixchannel(cptr, step, ( ((j&3)==1) || ((j&3)==2) ) ? mixr : mixl, run);
                     }
                 }
 
-                if( trkbuf && !state_remaining_steps )
+                for(k = 0; k < run; k++)
                 {
-                    state_remaining_steps = trkbuf->sample_step;
+                    l = mixl[k];
+                    r = mixr[k];
 
-                    if(trkbuf->nb_of_state < trkbuf->nb_max_of_state)
-                        trkbuf->nb_of_state++;
-                }
-                else
-                {
-                    state_remaining_steps--;
-                }
+                    tl = (short)l;
+                    tr = (short)r;
 
-                tl = (short)l;
-                tr = (short)r;
-
-                if ( modctx->filter )
-                {
-                    // Filter
-                    l = (l+ll)>>1;
-                    r = (r+lr)>>1;
-                }
+                    if ( modctx->filter )
+                    {
+                        // Filter
+                        l = (l+ll)>>1;
+                        r = (r+lr)>>1;
+                    }
 
-                if ( modctx->stereo_separation == 1 )
-                {
-                    // Left & Right Stereo panning
-                    l = (l+(r>>1));
-                    r = (r+(l>>1));
-                }
+                    if ( modctx->stereo_separation == 1 )
+                    {
+                        // Left & Right Stereo panning
+                        l = (l+(r>>1));
+                        r = (r+(l>>1));
+                    }
 
-                // Level limitation
-                if( l > 32767 ) l = 32767;
-                if( l < -32768 ) l = -32768;
-                if( r > 32767 ) r = 32767;
-                if( r < -32768 ) r = -32768;
+                    // Level limitation
+                    if( l > 32767 ) l = 32767;
+                    if( l < -32768 ) l = -32768;
+                    if( r > 32767 ) r = 32767;
+                    if( r < -32768 ) r = -32768;
 
-                // Store the final sample.
-                outbuffer[(i*2)]   = l;
-                outbuffer[(i*2)+1] = r;
+                    // Store the final sample.
+                    outbuffer[((i+k)*2)]   = l;
+                    outbuffer[((i+k)*2)+1] = r;
 
-                ll = tl;
-                lr = tr;
+                    ll = tl;
+                    lr = tr;
+                }
 
+                modctx->patternticks += run - 1;
+                modctx->patterntickse += run - 1;
+                i += run;
             }
 
             modctx->last_l_sample = ll;
@@ -1499,31 +1683,87 @@ static bool jar_mod_reset( jar_mod_context_t * modctx)
     return 0;
 }
 
+// Release the module data, mapped or copied, once no other context plays it
+static void jar_mod_free_modfile(jar_mod_context_t * modctx)
+{
+    if(!modctx->modfileusers || !--(*modctx->modfileusers))
+    {
+#ifdef JAR_MOD_MMAP
+        if(modctx->modfilemapped)
+            munmap(modctx->modfile, modctx->modfilesize);
+        else
+#endif
+            free(modctx->modfile);
+
+        free(modctx->modfileusers);
+    }
+
+    modctx->modfile = 0;
+    modctx->modfilesize = 0;
+    modctx->modfilemapped = 0;
+    modctx->modfileusers = 0;
+}
+
 void jar_mod_unload( jar_mod_context_t * modctx)
 {
     if(modctx)
     {
         if(modctx->modfile)
         {
-            free(modctx->modfile);
-            modctx->modfile = 0;
-            modctx->modfilesize = 0;
+            jar_mod_free_modfile(modctx);
             modctx->loopcount = 0;
         }
         jar_mod_reset(modctx);
     }
 }
 
+#ifdef JAR_MOD_MMAP
+// Map the module file read-only, the pages are shared with every other mapping of the file
+// Returns 0 when the file can't be mapped, the caller reads it instead
+static mulong jar_mod_map_file(jar_mod_context_t * modctx, const char* filename)
+{
+    struct stat st;
+    void * data;
+    int fd = open(filename, O_RDONLY);
+
+    if(fd < 0)
+        return 0;
+
+    // jar_mod_load() takes an int size
+    if(fstat(fd, &st) || st.st_size <= 0 || st.st_size > INT_MAX)
+    {
+        close(fd);
+        return 0;
+    }
+
+    data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file open
+
+    if(data == MAP_FAILED)
+        return 0;
+
+    modctx->modfile = (muchar *) data;
+    modctx->modfilesize = (mulong)st.st_size;
+    modctx->modfilemapped = 1;
 
+    return modctx->modfilesize;
+}
+#endif
 
 mulong jar_mod_load_file(jar_mod_context_t * modctx, const char* filename)
 {
     mulong fsize = 0;
     if(modctx->modfile)
+        jar_mod_free_modfile(modctx);
+
+#ifdef JAR_MOD_MMAP
+    fsize = jar_mod_map_file(modctx, filename);
+    if(fsize)
     {
-        free(modctx->modfile);
-        modctx->modfile = 0;
+        if(!jar_mod_load(modctx, (void*)modctx->modfile, fsize)) fsize = 0;
+        return fsize;
     }
+#endif
     
     FILE *f = fopen(filename, "rb");
     if(f)
@@ -1542,11 +1782,67 @@ mulong jar_mod_load_file(jar_mod_context_t * modctx, const char* filename)
             fclose(f);
             
             if(!jar_mod_load(modctx, (void*)modctx->modfile, fsize)) fsize = 0;
-        } else fsize = 0;
+        }
+        else
+        {
+            fclose(f);
+            fsize = 0;
+        }
     }
     return fsize;
 }
 
+// Like jar_mod_load_file(), the module is copied because samples are played straight from the module data
+mulong jar_mod_load_memory(jar_mod_context_t * modctx, const void* data, mulong size)
+{
+    if(modctx->modfile)
+        jar_mod_free_modfile(modctx);
+
+    if(!data || !size || size >= 32*1024*1024)
+        return 0;
+
+    modctx->modfile = (muchar *) malloc(size);
+    if(!modctx->modfile)
+        return 0;
+
+    modctx->modfilesize = size;
+    memcopy(modctx->modfile, (void*)data, size);
+
+    if(!jar_mod_load(modctx, (void*)modctx->modfile, size)) size = 0;
+
+    return size;
+}
+
+// The module data is never written once loaded, the contexts only share a user count
+mulong jar_mod_load_shared(jar_mod_context_t * modctx, jar_mod_context_t * source)
+{
+    if(modctx->modfile)
+        jar_mod_free_modfile(modctx);
+
+    if(!source || !source->modfile)
+        return 0;
+
+    if(!source->modfileusers)
+    {
+        source->modfileusers = (mulong *) malloc(sizeof(mulong));
+        if(!source->modfileusers)
+            return 0;
+
+        *source->modfileusers = 1;
+    }
+
+    if(!jar_mod_load(modctx, (void*)source->modfile, source->modfilesize))
+        return 0;
+
+    modctx->modfile = source->modfile;
+    modctx->modfilesize = source->modfilesize;
+    modctx->modfilemapped = source->modfilemapped;
+    modctx->modfileusers = source->modfileusers;
+    (*modctx->modfileusers)++;
+
+    return modctx->modfilesize;
+}
+
 mulong jar_mod_current_samples(jar_mod_context_t * modctx)
 {
     if(modctx)
@@ -1555,17 +1851,29 @@ mulong jar_mod_current_samples(jar_mod_context_t * modctx)
     return 0;
 }
 
-// Works, however it is very slow, this data should be cached to ensure it is run only once per file
+// Walks the sequencer only: rows are started like jar_mod_fillbuffer() does, the samples between two rows are counted
+// without being mixed. Gives the same count as mixing one sample at a time until the loop counter moves.
 mulong jar_mod_max_samples(jar_mod_context_t * ctx)
 {
-    mint buff[2];
     mulong len;
     mulong lastcount = ctx->loopcount;
-    
-    while(ctx->loopcount <= lastcount)
-        jar_mod_fillbuffer(ctx, buff, 1, 0);
-    
+
+    if( !ctx->mod_loaded )
+        return 0;
+
     len = ctx->samplenb;
+
+    while(ctx->loopcount <= lastcount)
+    {
+        // jar_mod_fillbuffer() starts a row on the sample where patternticks goes past patternticksaim
+        if( ctx->patternticks > ctx->patternticksaim )
+            len += 1;
+        else
+            len += ctx->patternticksaim + 2 - ctx->patternticks;
+
+        jar_mod_next_row(ctx);
+    }
+
     jar_mod_seek_start(ctx);
     
     return len;
@@ -1578,17 +1886,295 @@ void jar_mod_seek_start(jar_mod_context_t * ctx)
     {
         muchar* ftmp = ctx->modfile;
         mulong stmp = ctx->modfilesize;
+        muint mapped = ctx->modfilemapped;
+        mulong *users = ctx->modfileusers;
         muint lcnt = ctx->loopcount;
+        // jar_mod_reset() brings back the jar_mod_init() defaults, keep the configuration
+        mulong rate = ctx->playrate;
+        mint stereo = ctx->stereo;
+        mint separation = ctx->stereo_separation;
+        mint bits = ctx->bits;
+        mint filter = ctx->filter;
+        float pitch = ctx->pitch;
         
         if(jar_mod_reset(ctx)){
+            jar_mod_setcfg(ctx, rate, bits, stereo, separation, filter);
+            ctx->pitch = pitch;
             jar_mod_load(ctx, ftmp, stmp);
             ctx->modfile = ftmp;
             ctx->modfilesize = stmp;
+            ctx->modfilemapped = mapped;
+            ctx->modfileusers = users;
             ctx->loopcount = lcnt;
         }
     }
 }
 
+// Scale pitch and tempo together, like a different playrate but without resampling
+void jar_mod_set_pitch(jar_mod_context_t * modctx, float pitch)
+{
+    if( modctx && pitch > 0.0f )
+    {
+        modctx->pitch = pitch;
+
+        if( modctx->mod_loaded )
+        {
+            modctx->sampleticksconst = jar_mod_sampleticks(modctx);
+
+            if( modctx->bpm )
+                modctx->patternticksaim = (long)modctx->song.speed * ((jar_mod_tickrate(modctx) * 5 ) / (((long)2 * (long)modctx->bpm)));
+        }
+    }
+}
+
+// Advance playback without mixing. Rows and effects are processed on the same samples as jar_mod_fillbuffer() does,
+// channel positions are moved a whole effect tick at a time. Only the filter history differs from a mixed run.
+void jar_mod_skip_samples(jar_mod_context_t * modctx, unsigned long nbsample)
+{
+    unsigned long run, j;
+    unsigned char c;
+    mulong step, end, loop, aim;
+    short finalperiod;
+    note    *nptr;
+    channel *cptr;
+
+    if( !modctx || !modctx->mod_loaded )
+        return;
+
+    modctx->samplenb = modctx->samplenb + nbsample;
+
+    while( nbsample )
+    {
+        if( modctx->patternticks++ > modctx->patternticksaim )
+        {
+            jar_mod_next_row(modctx);
+        }
+
+        if( modctx->patterntickse++ > (modctx->patternticksaim/modctx->song.speed) )
+        {
+            nptr = modctx->patterndata[modctx->song.patterntable[modctx->tablepos]];
+            nptr = nptr + modctx->patternpos;
+            cptr = modctx->channels;
+
+            for(c=0;c<modctx->number_of_channels;c++)
+            {
+                workeffect(nptr+c, cptr+c);
+            }
+
+            modctx->patterntickse = 0;
+        }
+
+        // Samples until the next row or effect tick, periods can't change in between
+        run = ( modctx->patternticks <= modctx->patternticksaim + 1 ) ? modctx->patternticksaim + 2 - modctx->patternticks : 1;
+        aim = modctx->patternticksaim/modctx->song.speed;
+        if( modctx->patterntickse > aim + 1 )
+            run = 1;
+        else if( aim + 2 - modctx->patterntickse < run )
+            run = aim + 2 - modctx->patterntickse;
+        if( run > nbsample )
+            run = nbsample;
+
+        for(j =0, cptr = modctx->channels; j < modctx->number_of_channels ; j++, cptr++)
+        {
+            if( cptr->period != 0 )
+            {
+                finalperiod = cptr->period - cptr->decalperiod - cptr->vibraperiod;
+                step = finalperiod ? ( modctx->sampleticksconst / finalperiod ) : 0;
+
+                cptr->ticks += run;
+
+                if( cptr->replen<=2 )
+                {
+                    cptr->samppos += step * run;
+
+                    if( (cptr->samppos>>10) >= (cptr->length) )
+                    {
+                        cptr->length = 0;
+                        cptr->reppnt = 0;
+                        cptr->samppos = 0;
+                    }
+                }
+                else
+                {
+                    // The first sample wraps like jar_mod_fillbuffer(), after that the position stays in the loop
+                    end = ((unsigned long)(cptr->replen+cptr->reppnt))<<10;
+                    loop = ((unsigned long)cptr->replen)<<10;
+
+                    cptr->samppos += step;
+                    if( cptr->samppos >= end )
+                        cptr->samppos = ((unsigned long)(cptr->reppnt)<<10) + (cptr->samppos % end);
+
+                    cptr->samppos += step * (run - 1);
+                    if( cptr->samppos >= end )
+                        cptr->samppos = end - loop + ((cptr->samppos - end) % loop);
+                }
+            }
+        }
+
+        modctx->patternticks += run - 1;
+        modctx->patterntickse += run - 1;
+        nbsample -= run;
+    }
+
+    modctx->last_l_sample = 0;
+    modctx->last_r_sample = 0;
+}
+
+// Playback state saved by jar_mod_save_state(), sample data pointers are stored as sample numbers
+typedef struct {
+    mulong  size;
+    muint   number_of_channels;
+    muint   song_length;
+    mulong  playrate;
+    float   pitch;
+    muint   tablepos;
+    muint   patternpos;
+    muint   patterndelay;
+    muint   jump_loop_effect;
+    muchar  bpm;
+    muchar  speed;
+    mulong  patternticks;
+    mulong  patterntickse;
+    mulong  patternticksaim;
+    mulong  samplenb;
+    muint   loopcount;
+    mint    last_r_sample;
+    mint    last_l_sample;
+    muchar  has_sampdata[NUMMAXCHANNELS];
+    channel channels[NUMMAXCHANNELS];
+} jar_mod_state;
+
+mulong jar_mod_get_state_size(jar_mod_context_t * modctx)
+{
+    (void)modctx;
+    return sizeof(jar_mod_state);
+}
+
+void jar_mod_save_state(jar_mod_context_t * modctx, void * state)
+{
+    jar_mod_state * st = (jar_mod_state *)state;
+    muint i;
+
+    memclear(st, 0, sizeof(jar_mod_state));
+
+    st->size = sizeof(jar_mod_state);
+    st->number_of_channels = modctx->number_of_channels;
+    st->song_length = modctx->song.length;
+    st->playrate = modctx->playrate;
+    st->pitch = modctx->pitch;
+    st->tablepos = modctx->tablepos;
+    st->patternpos = modctx->patternpos;
+    st->patterndelay = modctx->patterndelay;
+    st->jump_loop_effect = modctx->jump_loop_effect;
+    st->bpm = modctx->bpm;
+    st->speed = modctx->song.speed;
+    st->patternticks = modctx->patternticks;
+    st->patterntickse = modctx->patterntickse;
+    st->patternticksaim = modctx->patternticksaim;
+    st->samplenb = modctx->samplenb;
+    st->loopcount = modctx->loopcount;
+    st->last_r_sample = modctx->last_r_sample;
+    st->last_l_sample = modctx->last_l_sample;
+
+    for(i = 0; i < NUMMAXCHANNELS; i++)
+    {
+        st->channels[i] = modctx->channels[i];
+        st->channels[i].sampdata = 0;
+        st->has_sampdata[i] = modctx->channels[i].sampdata != 0;
+    }
+}
+
+// Check the positions and sample numbers of a state against the module, they are used as indexes and sample offsets
+static bool jar_mod_check_state( jar_mod_context_t * modctx, const jar_mod_state * st )
+{
+    const channel * cptr;
+    const sample * sptr;
+    mulong rows_end, end;
+    muint i;
+
+    rows_end = 64 * (mulong)modctx->number_of_channels;
+
+    if( st->tablepos >= modctx->song.length || st->speed == 0 ||
+        st->patternpos >= rows_end || st->patternpos % modctx->number_of_channels )
+        return false;
+
+    for(i = 0; i < NUMMAXCHANNELS; i++)
+    {
+        cptr = &st->channels[i];
+
+        if( cptr->sampnum >= 31 || cptr->finetune > 15 || cptr->ArpIndex > 2 || cptr->patternloopstartpoint >= rows_end )
+            return false;
+
+        if( st->has_sampdata[i] )
+        {
+            sptr = &modctx->song.samples[cptr->sampnum];
+
+            if( !modctx->sampledata[cptr->sampnum] || cptr->length > sptr->length )
+                return false;
+
+            // Same wrap as mixchannel(), the position is inside the loop or the sample
+            if( cptr->replen > 2 )
+            {
+                end = (mulong)cptr->reppnt + cptr->replen;
+                if( end > sptr->length || (cptr->samppos>>10) >= end )
+                    return false;
+            }
+            else if( cptr->length && (cptr->samppos>>10) >= cptr->length )
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool jar_mod_load_state(jar_mod_context_t * modctx, const void * state)
+{
+    const jar_mod_state * st = (const jar_mod_state *)state;
+    muint i;
+
+    if( !modctx->mod_loaded || st->size != sizeof(jar_mod_state) ||
+        st->number_of_channels != modctx->number_of_channels || st->song_length != modctx->song.length ||
+        !jar_mod_check_state(modctx, st) )
+        return false;
+
+    modctx->tablepos = st->tablepos;
+    modctx->patternpos = st->patternpos;
+    modctx->patterndelay = st->patterndelay;
+    modctx->jump_loop_effect = st->jump_loop_effect;
+    modctx->bpm = st->bpm;
+    modctx->song.speed = st->speed;
+    modctx->patternticks = st->patternticks;
+    modctx->patterntickse = st->patterntickse;
+    modctx->samplenb = st->samplenb;
+    modctx->loopcount = st->loopcount;
+    modctx->last_r_sample = st->last_r_sample;
+    modctx->last_l_sample = st->last_l_sample;
+
+    for(i = 0; i < NUMMAXCHANNELS; i++)
+    {
+        modctx->channels[i] = st->channels[i];
+        if( st->has_sampdata[i] )
+            modctx->channels[i].sampdata = modctx->sampledata[modctx->channels[i].sampnum];
+    }
+
+    // Tick counters are in output samples, they depend on the playrate and the pitch
+    modctx->sampleticksconst = jar_mod_sampleticks(modctx);
+    if( modctx->bpm )
+        modctx->patternticksaim = (long)modctx->song.speed * ((jar_mod_tickrate(modctx) * 5 ) / (((long)2 * (long)modctx->bpm)));
+    else
+        modctx->patternticksaim = st->patternticksaim;
+
+    if( modctx->patternticksaim != st->patternticksaim && st->patternticksaim )
+    {
+        modctx->patternticks = (mulong)((double)st->patternticks * modctx->patternticksaim / st->patternticksaim);
+        modctx->patterntickse = (mulong)((double)st->patterntickse * modctx->patternticksaim / st->patternticksaim);
+    }
+
+    return true;
+}
+
 #endif // end of JAR_MOD_IMPLEMENTATION
 //-------------------------------------------------------------------------------
 
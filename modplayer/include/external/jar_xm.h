@@ -57,6 +57,16 @@
 #define JAR_XM_DEFENSIVE 1
 #define JAR_XM_RAMPING 1
 
+// Mix with integers: Q15 points and volumes, 32 bit position fractions and 32 bit sums.
+// Cheaper on CPUs with a slow FPU, on by default for 32 bit ARM Android. Define to 0 or 1 to choose.
+#ifndef JAR_XM_FIXED_POINT
+#if defined(__ANDROID__) && defined(__arm__)
+#define JAR_XM_FIXED_POINT 1
+#else
+#define JAR_XM_FIXED_POINT 0
+#endif
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -73,6 +83,15 @@ extern "C" {
 struct jar_xm_context_s;
 typedef struct jar_xm_context_s jar_xm_context_t;
 
+/** How samples are resampled to the play rate, see jar_xm_set_interpolation(). */
+enum jar_xm_interpolation_e {
+    jar_xm_NEAREST_INTERPOLATION,
+    jar_xm_LINEAR_INTERPOLATION,
+    jar_xm_CUBIC_INTERPOLATION, /* 4 point Catmull-Rom */
+    jar_xm_SINC_INTERPOLATION, /* 8 tap windowed sinc, low-passed for notes played above the rate */
+};
+typedef enum jar_xm_interpolation_e jar_xm_interpolation_t;
+
 /** Create a XM context.
  *
  * @param moddata the contents of the module
@@ -117,7 +136,23 @@ int jar_xm_create_context(jar_xm_context_t** ctx, const char* moddata, uint32_t
  */
 int jar_xm_create_context_safe(jar_xm_context_t** ctx, const char* moddata, size_t moddata_length, uint32_t rate);
 
-/** Free a XM context created by jar_xm_create_context(). */
+/** Create a XM context playing the module of another context.
+ *
+ * Patterns, instruments and sample data are shared, the new context only
+ * allocates its playback state. The contexts can be freed in any order.
+ *
+ * @note Creating and freeing contexts of the same module is not thread safe.
+ *
+ * @param source a context of the module to play
+ * @param rate play rate in Hz, recommended value of 48000
+ *
+ * @returns 0 on success
+ * @returns 2 if memory allocation failed
+ */
+int jar_xm_create_context_shared(jar_xm_context_t** ctx, jar_xm_context_t* source, uint32_t rate);
+
+/** Free a XM context created by jar_xm_create_context(). The module
+ * data is freed with the last context playing it. */
 void jar_xm_free_context(jar_xm_context_t* ctx);
 
 /** Play the module and put the sound samples in an output buffer.
@@ -176,6 +211,24 @@ void jar_xm_generate_samples_8bit(jar_xm_context_t* ctx, char* output, size_t nu
  * indefinitely. */
 void jar_xm_set_max_loop_count(jar_xm_context_t* ctx, uint8_t loopcnt);
 
+/** Set the playback pitch of the module. Pitch and tempo are scaled
+ * together, like playing the module at another sample rate, but the
+ * output is not resampled. Can be called between any two calls to
+ * jar_xm_generate_samples.
+ *
+ * @param pitch 1.0 is the original pitch, 2.0 is one octave higher,
+ * pitches that are not greater than 0 are ignored */
+void jar_xm_set_pitch(jar_xm_context_t* ctx, float pitch);
+
+/** Set how samples are resampled to the play rate. Linear by default,
+ * nearest if JAR_XM_LINEAR_INTERPOLATION is 0. Can be called between
+ * any two calls to jar_xm_generate_samples.
+ *
+ * @note The cubic and sinc coefficient tables are shared by all the
+ * contexts and filled by the first call asking for them, that call
+ * must not race another one. */
+void jar_xm_set_interpolation(jar_xm_context_t* ctx, jar_xm_interpolation_t interpolation);
+
 /** Get the loop count of the currently playing module. This value is
  * 0 when the module is still playing, 1 when the module has looped
  * once, etc. */
@@ -293,6 +346,28 @@ uint64_t jar_xm_get_latest_trigger_of_channel(jar_xm_context_t* ctx, uint16_t);
  */
 uint64_t jar_xm_get_remaining_samples(jar_xm_context_t* ctx);
 
+/** Advance playback without generating any audio. Rows, ticks, effects
+ * and sample positions move on as if the samples were generated.
+ * Positions are advanced a whole tick at a time, so they can differ
+ * from a generated run by float rounding. */
+void jar_xm_skip_samples(jar_xm_context_t* ctx, size_t numsamples);
+
+/** Get the size of a playback state, see jar_xm_save_state(). */
+size_t jar_xm_get_state_size(jar_xm_context_t* ctx);
+
+/** Copy the playback state (position, channels, envelopes, effect
+ * memory) into a buffer of jar_xm_get_state_size() bytes. Pointers
+ * are stored as indices, so the state can be loaded in any context
+ * of the same module built by the same program. */
+void jar_xm_save_state(jar_xm_context_t* ctx, void* state);
+
+/** Restore a playback state saved with jar_xm_save_state(). States
+ * saved at another rate or pitch are rescaled to the context.
+ *
+ * @returns 0 on success, 1 if the state doesn't match the module or
+ * holds a position or index out of its range */
+int jar_xm_load_state(jar_xm_context_t* ctx, const void* state);
+
 #ifdef __cplusplus
 }
 #endif
@@ -309,6 +384,27 @@ uint64_t jar_xm_get_remaining_samples(jar_xm_context_t* ctx);
 #include <math.h>
 #include <string.h>
 
+/* The cubic and sinc kernels take their dot products 4 taps at a time, define JAR_XM_NO_SIMD for the scalar loop */
+#if !defined(JAR_XM_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JAR_XM_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__) || defined(_M_ARM64)
+#define JAR_XM_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+// Module files are parsed from a read-only mapping on POSIX targets, without a temporary heap copy
+// NOTE: Android fopen() reads application assets, those can't be mapped
+#if !defined(JAR_XM_NO_MMAP) && ((defined(__linux__) && !defined(__ANDROID__)) || defined(__APPLE__))
+#define JAR_XM_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #if JAR_XM_DEBUG            //JAR_XM_DEBUG defined as 0
 #include <stdio.h>
 #define DEBUG(fmt, ...) do {                                        \
@@ -340,6 +436,11 @@ extern int __fail[-1];
 #define jar_xm_SAMPLE_RAMPING_POINTS 0x20
 #endif
 
+#define jar_xm_KERNEL_PHASES 256 /* Fractional positions of the coefficient tables, a power of two */
+#define jar_xm_SINC_TAPS 8
+#define jar_xm_SINC_TABLES 3 /* Cutoffs for steps up to 1.1875, 1.5 and above */
+#define jar_xm_SPAN_POINTS 256 /* Points of a voice played in one go between ticks */
+
 /* ----- Data types ----- */
 
 enum jar_xm_waveform_type_e {
@@ -395,9 +496,8 @@ struct jar_xm_sample_s {
     jar_xm_loop_type_t loop_type;
     float panning;
     int8_t relative_note;
-    uint64_t latest_trigger;
 
-    float* data;
+    void* data; /* int8_t or int16_t points, as the module stores them */
  };
  typedef struct jar_xm_sample_s jar_xm_sample_t;
 
@@ -412,8 +512,7 @@ struct jar_xm_sample_s {
      uint8_t vibrato_depth;
      uint8_t vibrato_rate;
      uint16_t volume_fadeout;
-     uint64_t latest_trigger;
-     bool muted;
+     uint32_t first_sample; /* Index of samples[0] in the context sample_triggers */
 
      jar_xm_sample_t* samples;
  };
@@ -442,7 +541,10 @@ struct jar_xm_sample_s {
      uint16_t num_channels;
      uint16_t num_patterns;
      uint16_t num_instruments;
+     uint32_t num_samples; /* Samples of all the instruments */
      jar_xm_frequency_type_t frequency_type;
+     uint16_t tempo; /* Initial speed */
+     uint16_t bpm;
      uint8_t pattern_table[PATTERN_ORDER_TABLE_LENGTH];
 
      jar_xm_pattern_t* patterns;
@@ -451,6 +553,20 @@ struct jar_xm_sample_s {
  };
  typedef struct jar_xm_module_s jar_xm_module_t;
 
+ /* Head of the module memory. The module is never written once loaded,
+  * contexts playing the same module share it. */
+ struct jar_xm_module_memory_s {
+     uint32_t references; /* Contexts playing the module */
+ };
+ typedef struct jar_xm_module_memory_s jar_xm_module_memory_t;
+
+ /* Playback state of an instrument, kept out of the shared module */
+ struct jar_xm_instrument_state_s {
+     uint64_t latest_trigger;
+     bool muted;
+ };
+ typedef struct jar_xm_instrument_state_s jar_xm_instrument_state_t;
+
  struct jar_xm_channel_context_s {
      float note;
      float orig_note; /* The original note before effect modifications, as read in the pattern. */
@@ -528,10 +644,34 @@ struct jar_xm_sample_s {
  };
  typedef struct jar_xm_channel_context_s jar_xm_channel_context_t;
 
+ /* Channel state read on every output frame, one array per field. The
+  * channel contexts keep the state between jar_xm_generate_samples()
+  * calls and ticks, the voices are loaded from them for the frames in
+  * between. */
+ struct jar_xm_voices_s {
+     jar_xm_sample_t** sample; /* NULL when the channel plays nothing */
+     float* position;
+     float* step;
+     bool* ping;
+     bool* audible; /* Neither the channel nor its instrument are muted */
+     float* volume;
+     float* panning;
+#if JAR_XM_RAMPING
+     float* target_volume;
+     float* target_panning;
+     unsigned long* frame_count;
+#endif
+     int64_t* exact_position; /* Position scaled by 2^32, used while position still holds it rounded */
+ };
+ typedef struct jar_xm_voices_s jar_xm_voices_t;
+
  struct jar_xm_context_s {
      void* allocated_memory;
+     jar_xm_module_memory_t* module_memory; /* Patterns, instruments and samples of module */
      jar_xm_module_t module;
      uint32_t rate;
+     float pitch; /* Playback pitch, scales the channel steps and the tick length */
+     jar_xm_interpolation_t interpolation;
 
      uint16_t tempo;
      uint16_t bpm;
@@ -566,6 +706,9 @@ struct jar_xm_sample_s {
      uint8_t max_loop_count;
 
      jar_xm_channel_context_t* channels;
+     jar_xm_voices_t voices; /* Arrays of size module.num_channels */
+     jar_xm_instrument_state_t* instruments; /* Array of size module.num_instruments */
+     uint64_t* sample_triggers; /* Array of size module.num_samples */
 };
 
 /* ----- Internal API ----- */
@@ -586,28 +729,36 @@ int jar_xm_check_sanity_postload(jar_xm_context_t*);
 
 #endif
 
-/** Get the number of bytes needed to store the module data in a
- * dynamically allocated blank context.
+/** Get the number of bytes needed to store the module data, which
+ * contexts playing the module share.
  *
  * Things that are dynamically allocated:
+ * - module memory header
  * - sample data
  * - sample structures in instruments
  * - pattern data
- * - row loop count arrays
  * - pattern structures in module
  * - instrument structures in module
- * - channel contexts
- * - context structure itself
+ */
+size_t jar_xm_get_memory_needed_for_module(const char*, size_t);
 
- * @returns 0 if everything looks OK.
+/** Get the number of bytes needed by a context playing a loaded module.
+ *
+ * Things that are dynamically allocated:
+ * - context structure itself
+ * - channel contexts
+ * - voice arrays
+ * - row loop count arrays
+ * - instrument states
+ * - sample trigger times
  */
-size_t jar_xm_get_memory_needed_for_context(const char*, size_t);
+size_t jar_xm_get_memory_needed_for_context(const jar_xm_module_t*);
 
-/** Populate the context from module data.
+/** Populate the module from module data.
  *
  * @returns pointer to the memory pool
  */
-char* jar_xm_load_module(jar_xm_context_t*, const char*, size_t, char*);
+char* jar_xm_load_module(jar_xm_module_t*, const char*, size_t, char*);
 
 int jar_xm_create_context(jar_xm_context_t** ctxp, const char* moddata, uint32_t rate) {
     return jar_xm_create_context_safe(ctxp, moddata, SIZE_MAX, rate);
@@ -615,24 +766,15 @@ int jar_xm_create_context(jar_xm_context_t** ctxp, const char* moddata, uint32_t
 
 #define ALIGN(x, b) (((x) + ((b) - 1)) & ~((b) - 1))
 #define ALIGN_PTR(x, b) (void*)(((uintptr_t)(x) + ((b) - 1)) & ~((b) - 1))
-int jar_xm_create_context_safe(jar_xm_context_t** ctxp, const char* moddata, size_t moddata_length, uint32_t rate) {
-#if JAR_XM_DEFENSIVE
-    int ret;
-#endif
+/* Allocate a context playing a loaded module and take a reference to the module memory */
+static int jar_xm_create_context_of_module(jar_xm_context_t** ctxp, const jar_xm_module_t* module, jar_xm_module_memory_t* module_memory, uint32_t rate) {
     size_t bytes_needed;
     char* mempool;
     jar_xm_context_t* ctx;
 
-#if JAR_XM_DEFENSIVE
-    if((ret = jar_xm_check_sanity_preload(moddata, moddata_length))) {
-        DEBUG("jar_xm_check_sanity_preload() returned %i, module is not safe to load", ret);
-        return 1;
-    }
-#endif
-
-    bytes_needed = jar_xm_get_memory_needed_for_context(moddata, moddata_length);
+    bytes_needed = jar_xm_get_memory_needed_for_context(module);
     mempool = (char *)malloc(bytes_needed);
-    if(mempool == NULL && bytes_needed > 0) {
+    if(mempool == NULL) {
         /* malloc() failed, trouble ahead */
         DEBUG("call to malloc() failed, returned %p", (void*)mempool);
         return 2;
@@ -645,14 +787,48 @@ int jar_xm_create_context_safe(jar_xm_context_t** ctxp, const char* moddata, siz
     ctx->allocated_memory = mempool; /* Keep original pointer for free() */
     mempool += sizeof(jar_xm_context_t);
 
+    ctx->module_memory = module_memory;
+    ctx->module_memory->references++;
+    ctx->module = *module;
+
     ctx->rate = rate;
-    mempool = jar_xm_load_module(ctx, moddata, moddata_length, mempool);
+    ctx->tempo = module->tempo;
+    ctx->bpm = module->bpm;
     mempool = (char *)ALIGN_PTR(mempool, 16);
 
     ctx->channels = (jar_xm_channel_context_t*)mempool;
     mempool += ctx->module.num_channels * sizeof(jar_xm_channel_context_t);
     mempool = (char *)ALIGN_PTR(mempool, 16);
 
+    {
+        const size_t num_voices = ctx->module.num_channels;
+        jar_xm_voices_t* v = &ctx->voices;
+
+#define jar_xm_VOICE_ARRAY(field, type) do {                    \
+            v->field = (type*)mempool;                          \
+            mempool += num_voices * sizeof(type);               \
+            mempool = (char *)ALIGN_PTR(mempool, 16);           \
+        } while(0)
+
+        jar_xm_VOICE_ARRAY(sample, jar_xm_sample_t*);
+        jar_xm_VOICE_ARRAY(position, float);
+        jar_xm_VOICE_ARRAY(step, float);
+        jar_xm_VOICE_ARRAY(volume, float);
+        jar_xm_VOICE_ARRAY(panning, float);
+        jar_xm_VOICE_ARRAY(ping, bool);
+        jar_xm_VOICE_ARRAY(audible, bool);
+#if JAR_XM_RAMPING
+        jar_xm_VOICE_ARRAY(target_volume, float);
+        jar_xm_VOICE_ARRAY(target_panning, float);
+        jar_xm_VOICE_ARRAY(frame_count, unsigned long);
+#endif
+        jar_xm_VOICE_ARRAY(exact_position, int64_t);
+
+#undef jar_xm_VOICE_ARRAY
+    }
+
+    ctx->pitch = 1.f;
+    ctx->interpolation = JAR_XM_LINEAR_INTERPOLATION ? jar_xm_LINEAR_INTERPOLATION : jar_xm_NEAREST_INTERPOLATION;
     ctx->global_volume = 1.f;
     ctx->amplification = .25f; /* XXX: some bad modules may still clip. Find out something better. */
 
@@ -676,14 +852,61 @@ int jar_xm_create_context_safe(jar_xm_context_t** ctxp, const char* moddata, siz
         ch->actual_panning = .5f;
     }
 
+    ctx->instruments = (jar_xm_instrument_state_t*)mempool;
+    mempool += ctx->module.num_instruments * sizeof(jar_xm_instrument_state_t);
     mempool = (char *)ALIGN_PTR(mempool, 16);
+
+    ctx->sample_triggers = (uint64_t*)mempool;
+    mempool += ctx->module.num_samples * sizeof(uint64_t);
+
     ctx->row_loop_count = (uint8_t*)mempool;
-    mempool += MAX_NUM_ROWS * sizeof(uint8_t);
+    mempool += MAX_NUM_ROWS * ctx->module.length * sizeof(uint8_t);
+
+    return 0;
+}
+
+int jar_xm_create_context_safe(jar_xm_context_t** ctxp, const char* moddata, size_t moddata_length, uint32_t rate) {
+#if JAR_XM_DEFENSIVE
+    int ret;
+#endif
+    size_t bytes_needed;
+    char* mempool;
+    jar_xm_module_memory_t* module_memory;
+    jar_xm_module_t module;
 
 #if JAR_XM_DEFENSIVE
-    if((ret = jar_xm_check_sanity_postload(ctx))) {
+    if((ret = jar_xm_check_sanity_preload(moddata, moddata_length))) {
+        DEBUG("jar_xm_check_sanity_preload() returned %i, module is not safe to load", ret);
+        return 1;
+    }
+#endif
+
+    bytes_needed = jar_xm_get_memory_needed_for_module(moddata, moddata_length);
+    mempool = (char *)malloc(bytes_needed);
+    if(mempool == NULL) {
+        /* malloc() failed, trouble ahead */
+        DEBUG("call to malloc() failed, returned %p", (void*)mempool);
+        return 2;
+    }
+
+    /* Initialize most of the fields to 0, 0.f, NULL or false depending on type */
+    memset(mempool, 0, bytes_needed);
+    memset(&module, 0, sizeof(module));
+
+    module_memory = (jar_xm_module_memory_t*)mempool;
+    mempool += ALIGN(sizeof(jar_xm_module_memory_t), 16);
+
+    jar_xm_load_module(&module, moddata, moddata_length, mempool);
+
+    if(jar_xm_create_context_of_module(ctxp, &module, module_memory, rate)) {
+        free(module_memory);
+        return 2;
+    }
+
+#if JAR_XM_DEFENSIVE
+    if((ret = jar_xm_check_sanity_postload(*ctxp))) {
         DEBUG("jar_xm_check_sanity_postload() returned %i, module is not safe to play", ret);
-        jar_xm_free_context(ctx);
+        jar_xm_free_context(*ctxp);
         return 1;
     }
 #endif
@@ -691,7 +914,14 @@ int jar_xm_create_context_safe(jar_xm_context_t** ctxp, const char* moddata, siz
     return 0;
 }
 
+int jar_xm_create_context_shared(jar_xm_context_t** ctxp, jar_xm_context_t* source, uint32_t rate) {
+    return jar_xm_create_context_of_module(ctxp, &source->module, source->module_memory, rate);
+}
+
 void jar_xm_free_context(jar_xm_context_t* ctx) {
+    if(--ctx->module_memory->references == 0) {
+        free(ctx->module_memory);
+    }
     free(ctx->allocated_memory);
 }
 
@@ -699,6 +929,73 @@ void jar_xm_set_max_loop_count(jar_xm_context_t* ctx, uint8_t loopcnt) {
     ctx->max_loop_count = loopcnt;
 }
 
+void jar_xm_set_pitch(jar_xm_context_t* ctx, float pitch) {
+    if(!(pitch > 0.f)) return;
+
+    ctx->pitch = pitch;
+
+    /* Notes keep playing at the new pitch, the tick length follows on the next tick */
+    for(uint8_t i = 0; i < ctx->module.num_channels; ++i) {
+        jar_xm_channel_context_t* ch = ctx->channels + i;
+        ch->step = ch->frequency * ctx->pitch / ctx->rate;
+    }
+}
+
+/* Kernel coefficients for each fractional position, one more phase than jar_xm_KERNEL_PHASES for t == 1 */
+static float jar_xm_cubic_kernel[jar_xm_KERNEL_PHASES + 1][4];
+static float jar_xm_sinc_kernel[jar_xm_SINC_TABLES][jar_xm_KERNEL_PHASES + 1][jar_xm_SINC_TAPS];
+static bool jar_xm_kernels_ready = false;
+
+static void jar_xm_init_kernels(void) {
+    static const float cutoffs[jar_xm_SINC_TABLES] = { .97f, .75f, .5f };
+    const double pi = 3.14159265358979323846;
+
+    if(jar_xm_kernels_ready) {
+        return;
+    }
+
+    for(uint32_t p = 0; p <= jar_xm_KERNEL_PHASES; ++p) {
+        double t = (double)p / jar_xm_KERNEL_PHASES;
+
+        /* Catmull-Rom spline through points -1, 0, 1 and 2 */
+        jar_xm_cubic_kernel[p][0] = (float)(.5 * (-t * t * t + 2. * t * t - t));
+        jar_xm_cubic_kernel[p][1] = (float)(.5 * (3. * t * t * t - 5. * t * t + 2.));
+        jar_xm_cubic_kernel[p][2] = (float)(.5 * (-3. * t * t * t + 4. * t * t + t));
+        jar_xm_cubic_kernel[p][3] = (float)(.5 * (t * t * t - t * t));
+
+        /* Blackman windowed sinc over points -3 to 4, normalized so that DC goes through unchanged */
+        for(uint32_t n = 0; n < jar_xm_SINC_TABLES; ++n) {
+            double sum = 0.;
+
+            for(uint32_t k = 0; k < jar_xm_SINC_TAPS; ++k) {
+                double x = (double)k - 3. - t;
+                double w = .42 + .5 * cos(pi * x / 4.) + .08 * cos(2. * pi * x / 4.);
+                double h = (x == 0.) ? 1. : sin(pi * cutoffs[n] * x) / (pi * cutoffs[n] * x);
+
+                if(x <= -4. || x >= 4.) {
+                    w = 0.;
+                }
+
+                jar_xm_sinc_kernel[n][p][k] = (float)(h * w);
+                sum += h * w;
+            }
+
+            for(uint32_t k = 0; k < jar_xm_SINC_TAPS; ++k) {
+                jar_xm_sinc_kernel[n][p][k] = (float)(jar_xm_sinc_kernel[n][p][k] / sum);
+            }
+        }
+    }
+
+    jar_xm_kernels_ready = true;
+}
+
+void jar_xm_set_interpolation(jar_xm_context_t* ctx, jar_xm_interpolation_t interpolation) {
+    if(interpolation == jar_xm_CUBIC_INTERPOLATION || interpolation == jar_xm_SINC_INTERPOLATION) {
+        jar_xm_init_kernels();
+    }
+    ctx->interpolation = interpolation;
+}
+
 uint8_t jar_xm_get_loop_count(jar_xm_context_t* ctx) {
     return ctx->loop_count;
 }
@@ -710,8 +1007,8 @@ bool jar_xm_mute_channel(jar_xm_context_t* ctx, uint16_t channel, bool mute) {
 }
 
 bool jar_xm_mute_instrument(jar_xm_context_t* ctx, uint16_t instr, bool mute) {
-    bool old = ctx->module.instruments[instr - 1].muted;
-    ctx->module.instruments[instr - 1].muted = mute;
+    bool old = ctx->instruments[instr - 1].muted;
+    ctx->instruments[instr - 1].muted = mute;
     return old;
 }
 
@@ -766,11 +1063,11 @@ void jar_xm_get_position(jar_xm_context_t* ctx, uint8_t* pattern_index, uint8_t*
 }
 
 uint64_t jar_xm_get_latest_trigger_of_instrument(jar_xm_context_t* ctx, uint16_t instr) {
-    return ctx->module.instruments[instr - 1].latest_trigger;
+    return ctx->instruments[instr - 1].latest_trigger;
 }
 
 uint64_t jar_xm_get_latest_trigger_of_sample(jar_xm_context_t* ctx, uint16_t instr, uint16_t sample) {
-    return ctx->module.instruments[instr - 1].samples[sample].latest_trigger;
+    return ctx->sample_triggers[ctx->module.instruments[instr - 1].first_sample + sample];
 }
 
 uint64_t jar_xm_get_latest_trigger_of_channel(jar_xm_context_t* ctx, uint16_t chn) {
@@ -848,8 +1145,8 @@ int jar_xm_check_sanity_postload(jar_xm_context_t* ctx) {
 
 #endif
 
-size_t jar_xm_get_memory_needed_for_context(const char* moddata, size_t moddata_length) {
-    size_t memory_needed = 0;
+size_t jar_xm_get_memory_needed_for_module(const char* moddata, size_t moddata_length) {
+    size_t memory_needed = ALIGN(sizeof(jar_xm_module_memory_t), 16);
     size_t offset = 60; /* Skip the first header */
     uint16_t num_channels;
     uint16_t num_patterns;
@@ -866,8 +1163,6 @@ size_t jar_xm_get_memory_needed_for_context(const char* moddata, size_t moddata_
     memory_needed += num_instruments * sizeof(jar_xm_instrument_t);
     memory_needed  = ALIGN(memory_needed, 16);
 
-    memory_needed += MAX_NUM_ROWS * READ_U16(offset + 4) * sizeof(uint8_t); /* Module length */
-
     /* Header size */
     offset += READ_U32(offset);
 
@@ -901,19 +1196,12 @@ size_t jar_xm_get_memory_needed_for_context(const char* moddata, size_t moddata_
 
         for(uint16_t j = 0; j < num_samples; ++j) {
             uint32_t sample_size;
-            uint8_t flags;
 
             sample_size = READ_U32(offset);
-            flags = READ_U8(offset + 14);
             sample_size_aggregate += sample_size;
 
-            if(flags & (1 << 4)) {
-                /* 16 bit sample */
-                memory_needed += sample_size * (sizeof(float) >> 1);
-            } else {
-                /* 8 bit sample */
-                memory_needed += sample_size * sizeof(float);
-            }
+            /* 8 and 16 bit points are kept as they are, the sample structures that follow stay aligned */
+            memory_needed += ALIGN(sample_size, 8);
 
             offset += sample_header_size;
         }
@@ -921,15 +1209,37 @@ size_t jar_xm_get_memory_needed_for_context(const char* moddata, size_t moddata_
         offset += sample_size_aggregate;
     }
 
-    memory_needed += num_channels * sizeof(jar_xm_channel_context_t);
-    memory_needed += sizeof(jar_xm_context_t);
+    return memory_needed;
+}
+
+static size_t jar_xm_get_memory_needed_for_voices(size_t num_voices) {
+    size_t memory_needed = ALIGN(num_voices * sizeof(jar_xm_sample_t*), 16);
+
+    memory_needed += 4 * ALIGN(num_voices * sizeof(float), 16);
+    memory_needed += 2 * ALIGN(num_voices * sizeof(bool), 16);
+#if JAR_XM_RAMPING
+    memory_needed += 2 * ALIGN(num_voices * sizeof(float), 16);
+    memory_needed += ALIGN(num_voices * sizeof(unsigned long), 16);
+#endif
+    memory_needed += ALIGN(num_voices * sizeof(int64_t), 16);
+
+    return memory_needed;
+}
+
+size_t jar_xm_get_memory_needed_for_context(const jar_xm_module_t* mod) {
+    size_t memory_needed = ALIGN(sizeof(jar_xm_context_t), 16);
+
+    memory_needed += ALIGN(mod->num_channels * sizeof(jar_xm_channel_context_t), 16);
+    memory_needed += jar_xm_get_memory_needed_for_voices(mod->num_channels);
+    memory_needed += ALIGN(mod->num_instruments * sizeof(jar_xm_instrument_state_t), 16);
+    memory_needed += mod->num_samples * sizeof(uint64_t);
+    memory_needed += MAX_NUM_ROWS * mod->length * sizeof(uint8_t);
 
     return memory_needed;
 }
 
-char* jar_xm_load_module(jar_xm_context_t* ctx, const char* moddata, size_t moddata_length, char* mempool) {
+char* jar_xm_load_module(jar_xm_module_t* mod, const char* moddata, size_t moddata_length, char* mempool) {
     size_t offset = 0;
-    jar_xm_module_t* mod = &(ctx->module);
 
     /* Read XM header */
     READ_MEMCPY(mod->name, offset + 17, MODULE_NAME_LENGTH);
@@ -956,8 +1266,8 @@ char* jar_xm_load_module(jar_xm_context_t* ctx, const char* moddata, size_t modd
     uint16_t flags = READ_U32(offset + 14);
     mod->frequency_type = (flags & (1 << 0)) ? jar_xm_LINEAR_FREQUENCIES : jar_xm_AMIGA_FREQUENCIES;
 
-    ctx->tempo = READ_U16(offset + 16);
-    ctx->bpm = READ_U16(offset + 18);
+    mod->tempo = READ_U16(offset + 16);
+    mod->bpm = READ_U16(offset + 18);
 
     READ_MEMCPY(mod->pattern_table, offset + 20, PATTERN_ORDER_TABLE_LENGTH);
     offset += header_size;
@@ -1044,7 +1354,7 @@ char* jar_xm_load_module(jar_xm_context_t* ctx, const char* moddata, size_t modd
     mempool = (char *) ALIGN_PTR(mempool, 16);
 
     /* Read instruments */
-    for(uint16_t i = 0; i < ctx->module.num_instruments; ++i) {
+    for(uint16_t i = 0; i < mod->num_instruments; ++i) {
         uint32_t sample_header_size = 0;
         jar_xm_instrument_t* instr = mod->instruments + i;
 
@@ -1104,6 +1414,9 @@ instr->vibrato_type = (jar_xm_waveform_type_t)READ_U8(offset + 235);
             instr->samples = NULL;
         }
 
+        instr->first_sample = mod->num_samples;
+        mod->num_samples += instr->num_samples;
+
         /* Instrument header size */
         offset += READ_U32(offset);
 
@@ -1132,18 +1445,15 @@ instr->vibrato_type = (jar_xm_waveform_type_t)READ_U8(offset + 235);
             sample->panning = (float)READ_U8(offset + 15) / (float)0xFF;
             sample->relative_note = (int8_t)READ_U8(offset + 16);
             READ_MEMCPY(sample->name, 18, SAMPLE_NAME_LENGTH);
-            sample->data = (float*)mempool;
+            sample->data = mempool;
+            mempool += ALIGN(sample->length, 8);
 
             if(sample->bits == 16) {
                 /* 16 bit sample */
-                mempool += sample->length * (sizeof(float) >> 1);
                 sample->loop_start >>= 1;
                 sample->loop_length >>= 1;
                 sample->loop_end >>= 1;
                 sample->length >>= 1;
-            } else {
-                /* 8 bit sample */
-                mempool += sample->length * sizeof(float);
             }
 
             offset += sample_header_size;
@@ -1154,18 +1464,21 @@ instr->vibrato_type = (jar_xm_waveform_type_t)READ_U8(offset + 235);
             jar_xm_sample_t* sample = instr->samples + j;
             uint32_t length = sample->length;
 
+            /* Points are stored as deltas */
             if(sample->bits == 16) {
+                int16_t* data = (int16_t*)sample->data;
                 int16_t v = 0;
                 for(uint32_t k = 0; k < length; ++k) {
                     v = v + (int16_t)READ_U16(offset + (k << 1));
-                    sample->data[k] = (float)v / (float)(1 << 15);
+                    data[k] = v;
                 }
                 offset += sample->length << 1;
             } else {
+                int8_t* data = (int8_t*)sample->data;
                 int8_t v = 0;
                 for(uint32_t k = 0; k < length; ++k) {
                     v = v + (int8_t)READ_U8(offset + k);
-                    sample->data[k] = (float)v / (float)(1 << 7);
+                    data[k] = v;
                 }
                 offset += sample->length;
             }
@@ -1212,8 +1525,9 @@ static void jar_xm_post_pattern_change(jar_xm_context_t*);
 static void jar_xm_row(jar_xm_context_t*);
 static void jar_xm_tick(jar_xm_context_t*);
 
-static float jar_xm_next_of_sample(jar_xm_channel_context_t*);
-static void jar_xm_sample(jar_xm_context_t*, float*, float*);
+#if JAR_XM_RAMPING
+static void jar_xm_save_end_of_sample(jar_xm_context_t*, jar_xm_channel_context_t*);
+#endif
 
 /* ----- Other oddities ----- */
 
@@ -1570,7 +1884,7 @@ static void jar_xm_update_frequency(jar_xm_context_t* ctx, jar_xm_channel_contex
             ch->vibrato_note_offset + ch->autovibrato_note_offset
         ))
     );
-    ch->step = ch->frequency / ctx->rate;
+    ch->step = ch->frequency * ctx->pitch / ctx->rate;
 }
 
 static void jar_xm_handle_note_and_instrument(jar_xm_context_t* ctx, jar_xm_channel_context_t* ch,
@@ -1610,9 +1924,7 @@ static void jar_xm_handle_note_and_instrument(jar_xm_context_t* ctx, jar_xm_chan
         } else {
             if(instr->sample_of_notes[s->note - 1] < instr->num_samples) {
 #if JAR_XM_RAMPING
-                for(unsigned int z = 0; z < jar_xm_SAMPLE_RAMPING_POINTS; ++z) {
-                    ch->end_of_previous_sample[z] = jar_xm_next_of_sample(ch);
-                }
+                jar_xm_save_end_of_sample(ctx, ch);
                 ch->frame_count = 0;
 #endif
                 ch->sample = instr->samples + instr->sample_of_notes[s->note - 1];
@@ -1992,10 +2304,12 @@ static void jar_xm_trigger_note(jar_xm_context_t* ctx, jar_xm_channel_context_t*
 
     ch->latest_trigger = ctx->generated_samples;
     if(ch->instrument != NULL) {
-        ch->instrument->latest_trigger = ctx->generated_samples;
+        ctx->instruments[ch->instrument - ctx->module.instruments].latest_trigger = ctx->generated_samples;
     }
-    if(ch->sample != NULL) {
-        ch->sample->latest_trigger = ctx->generated_samples;
+    /* The sample may still belong to the previous instrument, that trigger isn't recorded */
+    if(ch->sample != NULL && ch->instrument != NULL && ch->sample >= ch->instrument->samples
+       && ch->sample < ch->instrument->samples + ch->instrument->num_samples) {
+        ctx->sample_triggers[ch->instrument->first_sample + (ch->sample - ch->instrument->samples)] = ctx->generated_samples;
     }
 }
 
@@ -2392,180 +2706,1165 @@ static void jar_xm_tick(jar_xm_context_t* ctx) {
     }
 
     /* FT2 manual says number of ticks / second = BPM * 0.4 */
-    ctx->remaining_samples_in_tick += (float)ctx->rate / ((float)ctx->bpm * 0.4f);
+    ctx->remaining_samples_in_tick += (float)ctx->rate / ((float)ctx->bpm * 0.4f * ctx->pitch);
 }
 
-static float jar_xm_next_of_sample(jar_xm_channel_context_t* ch) {
-    if(ch->instrument == NULL || ch->sample == NULL || ch->sample_position < 0) {
-#if JAR_XM_RAMPING
-        if(ch->frame_count < jar_xm_SAMPLE_RAMPING_POINTS) {
-            return jar_xm_LERP(ch->end_of_previous_sample[ch->frame_count], .0f,
-                           (float)ch->frame_count / (float)jar_xm_SAMPLE_RAMPING_POINTS);
-        }
-#endif
-        return .0f;
+/* Sample point k, between -1 and 1 */
+static float jar_xm_sample_point(const jar_xm_sample_t* sample, uint32_t k) {
+    if(sample->bits == 16) {
+        return (float)((const int16_t*)sample->data)[k] * (1.f / (float)(1 << 15));
     }
-    if(ch->sample->length == 0) {
-        return .0f;
+    return (float)((const int8_t*)sample->data)[k] * (1.f / (float)(1 << 7));
+}
+
+#if defined(JAR_XM_SSE2)
+/* Four consecutive points from k, in point units */
+static __m128 jar_xm_sample_points4(const jar_xm_sample_t* sample, uint32_t k) {
+    __m128i v;
+    if(sample->bits == 16) {
+        v = _mm_loadl_epi64((const __m128i*)((const int16_t*)sample->data + k));
+        v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    } else {
+        int32_t word;
+        memcpy(&word, (const int8_t*)sample->data + k, 4);
+        v = _mm_cvtsi32_si128(word);
+        v = _mm_unpacklo_epi8(v, v);
+        v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 24);
     }
+    return _mm_cvtepi32_ps(v);
+}
 
-    float u, v, t;
-    uint32_t a, b;
-    a = (uint32_t)ch->sample_position; /* This cast is fine,
-                                        * sample_position will not
-                                        * go above integer
-                                        * ranges */
-    if(JAR_XM_LINEAR_INTERPOLATION) {
-        b = a + 1;
-        t = ch->sample_position - a; /* Cheaper than fmodf(., 1.f) */
+/* Products of taps consecutive points from start with kernel coefficients, summed per lane */
+static __m128 jar_xm_kernel_lanes(const jar_xm_sample_t* sample, uint32_t start, uint32_t taps, const float* coefs) {
+    __m128 sum = _mm_setzero_ps();
+
+    for(uint32_t k = 0; k < taps; k += 4) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(jar_xm_sample_points4(sample, start + k), _mm_loadu_ps(coefs + k)));
+    }
+    return sum;
+}
+#elif defined(JAR_XM_NEON)
+static float32x4_t jar_xm_sample_points4(const jar_xm_sample_t* sample, uint32_t k) {
+    int32x4_t v;
+    if(sample->bits == 16) {
+        v = vmovl_s16(vld1_s16((const int16_t*)sample->data + k));
+    } else {
+        uint32_t word;
+        memcpy(&word, (const int8_t*)sample->data + k, 4);
+        v = vmovl_s16(vget_low_s16(vmovl_s8(vreinterpret_s8_u32(vdup_n_u32(word)))));
     }
-    u = ch->sample->data[a];
+    return vcvtq_f32_s32(v);
+}
 
-    switch(ch->sample->loop_type) {
+static float32x4_t jar_xm_kernel_lanes(const jar_xm_sample_t* sample, uint32_t start, uint32_t taps, const float* coefs) {
+    float32x4_t sum = vdupq_n_f32(0.f);
 
-    case jar_xm_NO_LOOP:
-        if(JAR_XM_LINEAR_INTERPOLATION) {
-            v = (b < ch->sample->length) ? ch->sample->data[b] : .0f;
+    for(uint32_t k = 0; k < taps; k += 4) {
+        sum = vmlaq_f32(sum, jar_xm_sample_points4(sample, start + k), vld1q_f32(coefs + k));
+    }
+    return sum;
+}
+#endif
+
+/* Dot product of taps consecutive points from start with kernel coefficients, in point units */
+static float jar_xm_kernel_dot(const jar_xm_sample_t* sample, uint32_t start, uint32_t taps, const float* coefs) {
+#if defined(JAR_XM_SSE2)
+    __m128 sum = jar_xm_kernel_lanes(sample, start, taps, coefs);
+
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+#elif defined(JAR_XM_NEON)
+    float32x4_t sum = jar_xm_kernel_lanes(sample, start, taps, coefs);
+
+    float32x2_t half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+    return vget_lane_f32(vpadd_f32(half, half), 0);
+#else
+    float sum = 0.f;
+
+    for(uint32_t k = 0; k < taps; ++k) {
+        sum += (sample->bits == 16 ? (float)((const int16_t*)sample->data)[start + k]
+                                   : (float)((const int8_t*)sample->data)[start + k]) * coefs[k];
+    }
+
+    return sum;
+#endif
+}
+
+/* Kernel phase of the fractional part of a position */
+static uint32_t jar_xm_kernel_phase(float t) {
+    return (uint32_t)(t * jar_xm_KERNEL_PHASES + .5f);
+}
+
+/* Play n points from position whose taps all lie inside the played part
+ * of the sample, four points at a time. The lanes are summed in the same
+ * order as jar_xm_kernel_dot(), so the points don't depend on where the
+ * block starts. */
+static void jar_xm_kernel_points(const jar_xm_sample_t* sample, const float* table, uint32_t taps, uint32_t before,
+                                 int64_t position, int64_t step, float* points, size_t n) {
+    const float scale = (sample->bits == 16) ? 1.f / (float)(1 << 15) : 1.f / (float)(1 << 7);
+    size_t i = 0;
+
+#if defined(JAR_XM_SSE2) || defined(JAR_XM_NEON)
+    for(; i + 4 <= n; i += 4) {
+#if defined(JAR_XM_SSE2)
+        __m128 lanes[4];
+#else
+        float32x4_t lanes[4];
+#endif
+        for(int j = 0; j < 4; ++j) {
+            const uint32_t a = (uint32_t)(position >> 32);
+            const float t = (float)(uint32_t)position * (1.f / 4294967296.f);
+            lanes[j] = jar_xm_kernel_lanes(sample, a - before, taps, table + jar_xm_kernel_phase(t) * taps);
+            position += step;
         }
-        ch->sample_position += ch->step;
-        if(ch->sample_position >= ch->sample->length) {
-            ch->sample_position = -1;
+
+        /* Transposed horizontal sums, one point per lane */
+#if defined(JAR_XM_SSE2)
+        const __m128 s01 = _mm_add_ps(_mm_unpacklo_ps(lanes[0], lanes[1]), _mm_unpackhi_ps(lanes[0], lanes[1]));
+        const __m128 s23 = _mm_add_ps(_mm_unpacklo_ps(lanes[2], lanes[3]), _mm_unpackhi_ps(lanes[2], lanes[3]));
+        const __m128 sum = _mm_add_ps(_mm_movelh_ps(s01, s23), _mm_movehl_ps(s23, s01));
+        _mm_storeu_ps(points + i, _mm_mul_ps(sum, _mm_set1_ps(scale)));
+#else
+        const float32x2_t s01 = vpadd_f32(vadd_f32(vget_low_f32(lanes[0]), vget_high_f32(lanes[0])),
+                                          vadd_f32(vget_low_f32(lanes[1]), vget_high_f32(lanes[1])));
+        const float32x2_t s23 = vpadd_f32(vadd_f32(vget_low_f32(lanes[2]), vget_high_f32(lanes[2])),
+                                          vadd_f32(vget_low_f32(lanes[3]), vget_high_f32(lanes[3])));
+        vst1q_f32(points + i, vmulq_n_f32(vcombine_f32(s01, s23), scale));
+#endif
+    }
+#else
+    for(; i + 4 <= n; i += 4) {
+        const float* coefs[4];
+        uint32_t start[4];
+        float sum[4] = { 0.f, 0.f, 0.f, 0.f };
+
+        for(int j = 0; j < 4; ++j) {
+            const float t = (float)(uint32_t)position * (1.f / 4294967296.f);
+            start[j] = (uint32_t)(position >> 32) - before;
+            coefs[j] = table + jar_xm_kernel_phase(t) * taps;
+            position += step;
         }
-        break;
 
-    case jar_xm_FORWARD_LOOP:
-        if(JAR_XM_LINEAR_INTERPOLATION) {
-            v = ch->sample->data[
-                (b == ch->sample->loop_end) ? ch->sample->loop_start : b
-            ];
+        /* Four independent sums, each in the order of jar_xm_kernel_dot() */
+        for(uint32_t k = 0; k < taps; ++k) {
+            for(int j = 0; j < 4; ++j) {
+                sum[j] += (sample->bits == 16 ? (float)((const int16_t*)sample->data)[start[j] + k]
+                                              : (float)((const int8_t*)sample->data)[start[j] + k]) * coefs[j][k];
+            }
         }
-        ch->sample_position += ch->step;
-        while(ch->sample_position >= ch->sample->loop_end) {
-            ch->sample_position -= ch->sample->loop_length;
+
+        for(int j = 0; j < 4; ++j) {
+            points[i + j] = sum[j] * scale;
         }
-        break;
+    }
+#endif
 
-    case jar_xm_PING_PONG_LOOP:
-        if(ch->ping) {
-            ch->sample_position += ch->step;
-        } else {
-            ch->sample_position -= ch->step;
+    for(; i < n; ++i) {
+        const uint32_t a = (uint32_t)(position >> 32);
+        const float t = (float)(uint32_t)position * (1.f / 4294967296.f);
+        points[i] = jar_xm_kernel_dot(sample, a - before, taps, table + jar_xm_kernel_phase(t) * taps) * scale;
+        position += step;
+    }
+}
+
+/* Point played at index i, which may be past the loop, -1 when it is silence */
+static int32_t jar_xm_tap_index(const jar_xm_sample_t* sample, bool ping, int32_t i) {
+    const int32_t start = (int32_t)sample->loop_start;
+    const int32_t end = (int32_t)sample->loop_end;
+
+    if(sample->loop_type == jar_xm_NO_LOOP || sample->loop_length == 0) {
+        return (i >= 0 && i < (int32_t)sample->length) ? i : -1;
+    }
+
+    if(sample->loop_type == jar_xm_FORWARD_LOOP) {
+        if(i >= end) {
+            i = start + (i - start) % (int32_t)sample->loop_length;
+        }
+    } else {
+        /* Ping-pong loops are mirrored at their ends, the start only once the loop is running backwards */
+        while(i >= end || (!ping && i < start)) {
+            i = (i >= end) ? 2 * end - 1 - i : 2 * start - 1 - i;
         }
-        /* XXX: this may not work for very tight ping-pong loops
-         * (ie switches direction more than once per sample */
-        if(ch->ping) {
-            if(JAR_XM_LINEAR_INTERPOLATION) {
-                v = (b >= ch->sample->loop_end) ? ch->sample->data[a] : ch->sample->data[b];
+    }
+
+    return (i >= 0) ? i : -1;
+}
+
+/* Point at a position with a cubic or sinc kernel of taps coefficients
+ * per phase, before of them ahead of the point */
+static float jar_xm_kernel_of_sample(const jar_xm_sample_t* sample, const float* table, uint32_t taps, uint32_t before, uint32_t a, float t, bool ping) {
+    const float scale = (sample->bits == 16) ? 1.f / (float)(1 << 15) : 1.f / (float)(1 << 7);
+    const float* coefs = table + jar_xm_kernel_phase(t) * taps;
+
+    /* Points past the loop end are never played, so the fast path stops at it */
+    const uint32_t end = (sample->loop_type == jar_xm_NO_LOOP || sample->loop_length == 0) ? sample->length : sample->loop_end;
+    const bool mirrored = sample->loop_type == jar_xm_PING_PONG_LOOP && !ping && a < sample->loop_start + before;
+
+    if(a >= before && a - before + taps <= end && !mirrored) {
+        return jar_xm_kernel_dot(sample, a - before, taps, coefs) * scale;
+    }
+
+    /* Near the ends, gather the points the way the loop plays them */
+    float sum = 0.f;
+    for(uint32_t k = 0; k < taps; ++k) {
+        int32_t i = jar_xm_tap_index(sample, ping, (int32_t)(a + k) - (int32_t)before);
+        if(i >= 0) {
+            sum += jar_xm_sample_point(sample, (uint32_t)i) * coefs[k];
+        }
+    }
+    return sum;
+}
+
+/* Position of a voice scaled by 2^32. The exact position carries over to
+ * the next run unless the channel moved it, so long samples don't drift
+ * with the rounding of the float position. Floats convert to it exactly. */
+static int64_t jar_xm_exact_position(const jar_xm_voices_t* vc, uint8_t voice) {
+    const int64_t position = vc->exact_position[voice];
+
+    if((float)((double)position / 4294967296.) != vc->position[voice]) {
+        return (int64_t)((double)vc->position[voice] * 4294967296.);
+    }
+    return position;
+}
+
+/* Play up to numpoints points of a voice, without ramping. The voice
+ * state is kept in locals for the whole run.
+ *
+ * @returns the number of points played, less than numpoints if the
+ * sample ended */
+static size_t jar_xm_sample_points(jar_xm_context_t* ctx, uint8_t voice, float* points, size_t numpoints) {
+    jar_xm_voices_t* vc = &ctx->voices;
+    const jar_xm_sample_t* smp = vc->sample[voice];
+    const jar_xm_interpolation_t interpolation = ctx->interpolation;
+    const bool linear = interpolation == jar_xm_LINEAR_INTERPOLATION;
+    const bool kernel = interpolation >= jar_xm_CUBIC_INTERPOLATION;
+    const float fstep = vc->step[voice];
+    bool ping = vc->ping[voice];
+    bool ended = false;
+    size_t i;
+
+    if(smp->length == 0) {
+        memset(points, 0, numpoints * sizeof(float));
+        return numpoints;
+    }
+
+    /* Same positions as the fixed point mixer, see jar_xm_sample_points_q15() */
+    const int64_t length = (int64_t)smp->length << 32;
+    const int64_t loop_start = (int64_t)smp->loop_start << 32;
+    const int64_t loop_end = (int64_t)smp->loop_end << 32;
+    const int64_t loop_length = (int64_t)smp->loop_length << 32;
+    const int64_t step = (int64_t)((double)fstep * 4294967296.);
+    int64_t position = jar_xm_exact_position(vc, voice);
+
+    /* The kernel table is chosen once per run */
+    const float* table = NULL;
+    uint32_t taps = 0, before = 0;
+    if(interpolation == jar_xm_CUBIC_INTERPOLATION) {
+        table = &jar_xm_cubic_kernel[0][0];
+        taps = 4;
+        before = 1;
+    } else if(kernel) {
+        /* Notes played above the rate are low-passed, or their upper harmonics fold back */
+        table = &jar_xm_sinc_kernel[(fstep > 1.5f) ? 2 : (fstep > 1.1875f) ? 1 : 0][0][0];
+        taps = jar_xm_SINC_TAPS;
+        before = 3;
+    }
+
+    /* Forward points have all their taps inside the played part of the
+     * sample from block_start until block_end, and are not wrapped, turned
+     * or ended until turn */
+    const uint32_t end = (smp->loop_type == jar_xm_NO_LOOP || smp->loop_length == 0) ? smp->length : smp->loop_end;
+    const int64_t block_start = (int64_t)before << 32;
+    const int64_t block_end = ((int64_t)end + before - taps + 1) << 32;
+    const int64_t turn = (smp->loop_type == jar_xm_NO_LOOP) ? length : loop_end;
+
+    for(i = 0; i < numpoints && !ended;) {
+        if(kernel && (ping || smp->loop_type != jar_xm_PING_PONG_LOOP) && position >= block_start && position < block_end) {
+            size_t n = numpoints - i;
+            if(step > 0) {
+                const int64_t inside = (block_end - 1 - position) / step + 1;
+                const int64_t unwrapped = (turn - 1 - position) / step;
+                const int64_t points_left = (inside < unwrapped) ? inside : unwrapped;
+                if((uint64_t)points_left < n) {
+                    n = (size_t)points_left;
+                }
             }
-            if(ch->sample_position >= ch->sample->loop_end) {
-                ch->ping = false;
-                ch->sample_position = (ch->sample->loop_end << 1) - ch->sample_position;
+            if(n > 0) {
+                jar_xm_kernel_points(smp, table, taps, before, position, step, points + i, n);
+                position += (int64_t)n * step;
+                i += n;
+                continue;
             }
-            /* sanity checking */
-            if(ch->sample_position >= ch->sample->length) {
-                ch->ping = false;
-                ch->sample_position -= ch->sample->length - 1;
+        }
+
+        const uint32_t a = (uint32_t)(position >> 32);
+        const uint32_t b = a + 1;
+        const float t = (float)(uint32_t)position * (1.f / 4294967296.f);
+        const float k = kernel ? jar_xm_kernel_of_sample(smp, table, taps, before, a, t, ping) : .0f;
+        float u = jar_xm_sample_point(smp, a), v = .0f;
+
+        switch(smp->loop_type) {
+
+        case jar_xm_NO_LOOP:
+            if(linear) {
+                v = (b < smp->length) ? jar_xm_sample_point(smp, b) : .0f;
             }
-        } else {
-            if(JAR_XM_LINEAR_INTERPOLATION) {
-                v = u;
-                u = (b == 1 || b - 2 <= ch->sample->loop_start) ? ch->sample->data[a] : ch->sample->data[b - 2];
+            position += step;
+            ended = position >= length;
+            break;
+
+        case jar_xm_FORWARD_LOOP:
+            if(linear) {
+                v = jar_xm_sample_point(smp, (b == smp->loop_end) ? smp->loop_start : b);
             }
-            if(ch->sample_position <= ch->sample->loop_start) {
-                ch->ping = true;
-                ch->sample_position = (ch->sample->loop_start << 1) - ch->sample_position;
+            position += step;
+            while(position >= loop_end) {
+                position -= loop_length;
             }
-            /* sanity checking */
-            if(ch->sample_position <= .0f) {
-                ch->ping = true;
-                ch->sample_position = .0f;
+            break;
+
+        case jar_xm_PING_PONG_LOOP:
+            /* XXX: this may not work for very tight ping-pong loops
+             * (ie switches direction more than once per sample */
+            if(ping) {
+                if(linear) {
+                    v = (b >= smp->loop_end) ? u : jar_xm_sample_point(smp, b);
+                }
+                position += step;
+                if(position >= loop_end) {
+                    ping = false;
+                    position = (loop_end << 1) - position;
+                }
+                /* sanity checking */
+                if(position >= length) {
+                    ping = false;
+                    position -= length - ((int64_t)1 << 32);
+                }
+            } else {
+                if(linear) {
+                    v = u;
+                    u = (b == 1 || b - 2 <= smp->loop_start) ? u : jar_xm_sample_point(smp, b - 2);
+                }
+                position -= step;
+                if(position <= loop_start) {
+                    ping = true;
+                    position = (loop_start << 1) - position;
+                }
+                /* sanity checking */
+                if(position <= 0) {
+                    ping = true;
+                    position = 0;
+                }
             }
+            break;
+
+        default:
+            break;
         }
-        break;
 
-    default:
-        v = .0f;
-        break;
+        points[i++] = linear ? jar_xm_LERP(u, v, t) : kernel ? k : u;
+    }
+
+    vc->exact_position[voice] = position;
+    vc->position[voice] = ended ? -1.f : (float)((double)position / 4294967296.);
+    vc->ping[voice] = ping;
+    return i;
+}
+
+static float jar_xm_next_of_sample(jar_xm_context_t* ctx, uint8_t voice) {
+    jar_xm_voices_t* vc = &ctx->voices;
+    const jar_xm_sample_t* smp = vc->sample[voice];
+
+    if(smp == NULL || vc->position[voice] < 0) {
+#if JAR_XM_RAMPING
+        const unsigned long frame_count = vc->frame_count[voice];
+        if(frame_count < jar_xm_SAMPLE_RAMPING_POINTS) {
+            return jar_xm_LERP(ctx->channels[voice].end_of_previous_sample[frame_count], .0f,
+                           (float)frame_count / (float)jar_xm_SAMPLE_RAMPING_POINTS);
+        }
+#endif
+        return .0f;
+    }
+    if(smp->length == 0) {
+        return .0f;
     }
 
-    float endval = JAR_XM_LINEAR_INTERPOLATION ? jar_xm_LERP(u, v, t) : u;
+    float endval;
+    jar_xm_sample_points(ctx, voice, &endval, 1);
 
 #if JAR_XM_RAMPING
-    if(ch->frame_count < jar_xm_SAMPLE_RAMPING_POINTS) {
+    const unsigned long frame_count = vc->frame_count[voice];
+    if(frame_count < jar_xm_SAMPLE_RAMPING_POINTS) {
         /* Smoothly transition between old and new sample. */
-        return jar_xm_LERP(ch->end_of_previous_sample[ch->frame_count], endval,
-                       (float)ch->frame_count / (float)jar_xm_SAMPLE_RAMPING_POINTS);
+        return jar_xm_LERP(ctx->channels[voice].end_of_previous_sample[frame_count], endval,
+                       (float)frame_count / (float)jar_xm_SAMPLE_RAMPING_POINTS);
     }
 #endif
 
     return endval;
 }
 
-static void jar_xm_sample(jar_xm_context_t* ctx, float* left, float* right) {
-    if(ctx->remaining_samples_in_tick <= 0) {
-        jar_xm_tick(ctx);
+#if JAR_XM_FIXED_POINT
+#define jar_xm_TO_Q15(x) ((int32_t)((x) * 32768.f))
+
+/* Q15 point of a sample, 8 bit points fill the upper byte */
+static int32_t jar_xm_sample_point_q15(const jar_xm_sample_t* sample, uint32_t k) {
+    return (sample->bits == 16) ? ((const int16_t*)sample->data)[k] : ((const int8_t*)sample->data)[k] * 256;
+}
+
+/* jar_xm_sample_points() with Q15 points, on the same exact positions.
+ * Cubic and sinc kernels are still taken in float. */
+static size_t jar_xm_sample_points_q15(jar_xm_context_t* ctx, uint8_t voice, int32_t* points, size_t numpoints) {
+    jar_xm_voices_t* vc = &ctx->voices;
+    const jar_xm_sample_t* smp = vc->sample[voice];
+    const bool linear = ctx->interpolation == jar_xm_LINEAR_INTERPOLATION;
+    size_t i;
+
+    if(ctx->interpolation >= jar_xm_CUBIC_INTERPOLATION) {
+        float fpoints[jar_xm_SPAN_POINTS];
+        const size_t played = jar_xm_sample_points(ctx, voice, fpoints, numpoints);
+        for(i = 0; i < played; ++i) {
+            points[i] = jar_xm_TO_Q15(fpoints[i]);
+        }
+        return played;
     }
-    ctx->remaining_samples_in_tick--;
 
-    *left = 0.f;
-    *right = 0.f;
+    if(smp->length == 0) {
+        memset(points, 0, numpoints * sizeof(int32_t));
+        return numpoints;
+    }
 
-    if(ctx->max_loop_count > 0 && ctx->loop_count >= ctx->max_loop_count) {
-        return;
+    const int64_t length = (int64_t)smp->length << 32;
+    const int64_t loop_start = (int64_t)smp->loop_start << 32;
+    const int64_t loop_end = (int64_t)smp->loop_end << 32;
+    const int64_t loop_length = (int64_t)smp->loop_length << 32;
+    const int64_t step = (int64_t)((double)vc->step[voice] * 4294967296.);
+    int64_t position = jar_xm_exact_position(vc, voice);
+    bool ping = vc->ping[voice];
+    bool ended = false;
+
+    for(i = 0; i < numpoints && !ended; ++i) {
+        const uint32_t a = (uint32_t)(position >> 32);
+        const uint32_t b = a + 1;
+        const int32_t t = (int32_t)((position >> 17) & 0x7FFF); /* Q15 */
+        int32_t u = jar_xm_sample_point_q15(smp, a), v = 0;
+
+        switch(smp->loop_type) {
+
+        case jar_xm_NO_LOOP:
+            if(linear) {
+                v = (b < smp->length) ? jar_xm_sample_point_q15(smp, b) : 0;
+            }
+            position += step;
+            ended = position >= length;
+            break;
+
+        case jar_xm_FORWARD_LOOP:
+            if(linear) {
+                v = jar_xm_sample_point_q15(smp, (b == smp->loop_end) ? smp->loop_start : b);
+            }
+            position += step;
+            while(position >= loop_end) {
+                position -= loop_length;
+            }
+            break;
+
+        case jar_xm_PING_PONG_LOOP:
+            /* Same turns as the float path, see jar_xm_sample_points() */
+            if(ping) {
+                if(linear) {
+                    v = (b >= smp->loop_end) ? u : jar_xm_sample_point_q15(smp, b);
+                }
+                position += step;
+                if(position >= loop_end) {
+                    ping = false;
+                    position = (loop_end << 1) - position;
+                }
+                if(position >= length) {
+                    ping = false;
+                    position -= length - ((int64_t)1 << 32);
+                }
+            } else {
+                if(linear) {
+                    v = u;
+                    u = (b == 1 || b - 2 <= smp->loop_start) ? u : jar_xm_sample_point_q15(smp, b - 2);
+                }
+                position -= step;
+                if(position <= loop_start) {
+                    ping = true;
+                    position = (loop_start << 1) - position;
+                }
+                if(position <= 0) {
+                    ping = true;
+                    position = 0;
+                }
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        points[i] = linear ? u + (((v - u) * t) >> 15) : u;
     }
 
+    vc->exact_position[voice] = position;
+    vc->position[voice] = ended ? -1.f : (float)((double)position / 4294967296.);
+    vc->ping[voice] = ping;
+    return i;
+}
+#endif
+
+/* Copy the state the mixer reads from a channel context into its voice */
+static void jar_xm_load_voice(jar_xm_context_t* ctx, uint8_t voice) {
+    const jar_xm_channel_context_t* ch = ctx->channels + voice;
+    jar_xm_voices_t* vc = &ctx->voices;
+
+    vc->sample[voice] = (ch->instrument != NULL) ? ch->sample : NULL;
+    vc->position[voice] = ch->sample_position;
+    vc->step[voice] = ch->step;
+    vc->ping[voice] = ch->ping;
+    vc->audible[voice] = !ch->muted && (ch->instrument == NULL || !ctx->instruments[ch->instrument - ctx->module.instruments].muted);
+    vc->volume[voice] = ch->actual_volume;
+    vc->panning[voice] = ch->actual_panning;
+#if JAR_XM_RAMPING
+    vc->target_volume[voice] = ch->target_volume;
+    vc->target_panning[voice] = ch->target_panning;
+    vc->frame_count[voice] = ch->frame_count;
+#endif
+}
+
+/* Copy back what the mixer changed in a voice to its channel context */
+static void jar_xm_store_voice(jar_xm_context_t* ctx, uint8_t voice) {
+    jar_xm_channel_context_t* ch = ctx->channels + voice;
+    const jar_xm_voices_t* vc = &ctx->voices;
+
+    ch->sample_position = vc->position[voice];
+    ch->ping = vc->ping[voice];
+    ch->actual_volume = vc->volume[voice];
+    ch->actual_panning = vc->panning[voice];
+#if JAR_XM_RAMPING
+    ch->frame_count = vc->frame_count[voice];
+#endif
+}
+
+static void jar_xm_load_voices(jar_xm_context_t* ctx) {
     for(uint8_t i = 0; i < ctx->module.num_channels; ++i) {
-        jar_xm_channel_context_t* ch = ctx->channels + i;
+        jar_xm_load_voice(ctx, i);
+    }
+}
+
+static void jar_xm_store_voices(jar_xm_context_t* ctx) {
+    for(uint8_t i = 0; i < ctx->module.num_channels; ++i) {
+        jar_xm_store_voice(ctx, i);
+    }
+}
 
-        if(ch->instrument == NULL || ch->sample == NULL || ch->sample_position < 0) {
+#if JAR_XM_RAMPING
+/* Play on the end of the channel sample, the new one fades in from it */
+static void jar_xm_save_end_of_sample(jar_xm_context_t* ctx, jar_xm_channel_context_t* ch) {
+    const uint8_t voice = (uint8_t)(ch - ctx->channels);
+
+    jar_xm_load_voice(ctx, voice);
+    for(unsigned int z = 0; z < jar_xm_SAMPLE_RAMPING_POINTS; ++z) {
+        ch->end_of_previous_sample[z] = jar_xm_next_of_sample(ctx, voice);
+    }
+    jar_xm_store_voice(ctx, voice);
+}
+#endif
+
+#if !JAR_XM_FIXED_POINT
+/* Add rows of points from count voices to stereo frames, each voice with
+ * the volume and panning it holds until the next tick. The frames are
+ * summed over the voices in registers, in voice order, four at a time. */
+static void jar_xm_add_rows(float* output, float (*rows)[jar_xm_SPAN_POINTS], const float* volume, const float* panning,
+                            uint8_t count, size_t numpoints) {
+    size_t i = 0;
+
+#if defined(JAR_XM_SSE2)
+    for(; i + 4 <= numpoints; i += 4) {
+        const __m128 f0 = _mm_loadu_ps(output + 2 * i), f1 = _mm_loadu_ps(output + 2 * i + 4);
+        __m128 l = _mm_shuffle_ps(f0, f1, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 r = _mm_shuffle_ps(f0, f1, _MM_SHUFFLE(3, 1, 3, 1));
+
+        for(uint8_t k = 0; k < count; ++k) {
+            const __m128 gain = _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(volume[k]));
+            l = _mm_add_ps(l, _mm_mul_ps(gain, _mm_set1_ps(1.f - panning[k])));
+            r = _mm_add_ps(r, _mm_mul_ps(gain, _mm_set1_ps(panning[k])));
+        }
+
+        _mm_storeu_ps(output + 2 * i, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(output + 2 * i + 4, _mm_unpackhi_ps(l, r));
+    }
+#elif defined(JAR_XM_NEON)
+    for(; i + 4 <= numpoints; i += 4) {
+        float32x4x2_t frames = vld2q_f32(output + 2 * i);
+
+        for(uint8_t k = 0; k < count; ++k) {
+            const float32x4_t gain = vmulq_n_f32(vld1q_f32(rows[k] + i), volume[k]);
+            frames.val[0] = vaddq_f32(frames.val[0], vmulq_n_f32(gain, 1.f - panning[k]));
+            frames.val[1] = vaddq_f32(frames.val[1], vmulq_n_f32(gain, panning[k]));
+        }
+
+        vst2q_f32(output + 2 * i, frames);
+    }
+#endif
+
+    for(; i < numpoints; ++i) {
+        for(uint8_t k = 0; k < count; ++k) {
+            output[2 * i] += rows[k][i] * volume[k] * (1.f - panning[k]);
+            output[2 * i + 1] += rows[k][i] * volume[k] * panning[k];
+        }
+    }
+}
+
+/* Add the voices to numsamples frames which don't cross a tick,
+ * numsamples is at most jar_xm_SPAN_POINTS. The points of up to four
+ * voices are played into rows before they are added together. */
+static void jar_xm_render_voices(jar_xm_context_t* ctx, float* output, size_t numsamples) {
+    jar_xm_voices_t* vc = &ctx->voices;
+    float rows[4][jar_xm_SPAN_POINTS];
+    float volume[4], panning[4];
+    uint8_t count = 0;
+
+    for(uint8_t voice = 0; voice < ctx->module.num_channels; ++voice) {
+        size_t i = 0;
+
+        if(vc->sample[voice] == NULL) {
             continue;
         }
 
-        const float fval = jar_xm_next_of_sample(ch);
+#if JAR_XM_RAMPING
+        /* Frames fading from the previous sample or moving the volume are played one by one */
+        while(i < numsamples && vc->position[voice] >= 0 &&
+              (vc->frame_count[voice] < jar_xm_SAMPLE_RAMPING_POINTS ||
+               vc->volume[voice] != vc->target_volume[voice] || vc->panning[voice] != vc->target_panning[voice])) {
+            const float fval = jar_xm_next_of_sample(ctx, voice);
+
+            if(vc->audible[voice]) {
+                output[2 * i] += fval * vc->volume[voice] * (1.f - vc->panning[voice]);
+                output[2 * i + 1] += fval * vc->volume[voice] * vc->panning[voice];
+            }
 
-        if(!ch->muted && !ch->instrument->muted) {
-            *left += fval * ch->actual_volume * (1.f - ch->actual_panning);
-            *right += fval * ch->actual_volume * ch->actual_panning;
+            vc->frame_count[voice]++;
+            jar_xm_SLIDE_TOWARDS(vc->volume[voice], vc->target_volume[voice], ctx->volume_ramp);
+            jar_xm_SLIDE_TOWARDS(vc->panning[voice], vc->target_panning[voice], ctx->panning_ramp);
+            ++i;
         }
+#endif
+
+        if(i == numsamples || vc->position[voice] < 0) {
+            continue;
+        }
+
+        /* The volume holds until the next tick, the other points are played in a block */
+        float* row = rows[count];
+        const size_t played = jar_xm_sample_points(ctx, voice, row + i, numsamples - i);
+        memset(row, 0, i * sizeof(float));
+        memset(row + i + played, 0, (numsamples - i - played) * sizeof(float));
 
 #if JAR_XM_RAMPING
-        ch->frame_count++;
-        jar_xm_SLIDE_TOWARDS(ch->actual_volume, ch->target_volume, ctx->volume_ramp);
-        jar_xm_SLIDE_TOWARDS(ch->actual_panning, ch->target_panning, ctx->panning_ramp);
+        vc->frame_count[voice] += played;
 #endif
+
+        if(vc->audible[voice]) {
+            volume[count] = vc->volume[voice];
+            panning[count] = vc->panning[voice];
+            if(++count == 4) {
+                jar_xm_add_rows(output, rows, volume, panning, count, numsamples);
+                count = 0;
+            }
+        }
     }
 
-    const float fgvol = ctx->global_volume * ctx->amplification;
-    *left *= fgvol;
-    *right *= fgvol;
+    if(count > 0) {
+        jar_xm_add_rows(output, rows, volume, panning, count, numsamples);
+    }
+}
+
+#else
+/* Add a voice to numsamples frames of Q15 sums, numsamples is at most jar_xm_SPAN_POINTS */
+static void jar_xm_render_voice_q15(jar_xm_context_t* ctx, uint8_t voice, int32_t* output, size_t numsamples) {
+    jar_xm_voices_t* vc = &ctx->voices;
+    int32_t points[jar_xm_SPAN_POINTS];
+    size_t i = 0;
+
+    if(vc->sample[voice] == NULL || vc->position[voice] < 0) {
+        return;
+    }
+
+    const size_t played = jar_xm_sample_points_q15(ctx, voice, points, numsamples);
+    const bool audible = vc->audible[voice];
+    int32_t volume = jar_xm_TO_Q15(vc->volume[voice]);
+    int32_t panning = jar_xm_TO_Q15(vc->panning[voice]);
 
-#if JAR_XM_DEBUG
-    if(fabs(*left) > 1 || fabs(*right) > 1) {
-        DEBUG("clipping frame: %f %f, this is a bad module or a libxm bug", *left, *right);
+#if JAR_XM_RAMPING
+    const int32_t target_volume = jar_xm_TO_Q15(vc->target_volume[voice]);
+    const int32_t target_panning = jar_xm_TO_Q15(vc->target_panning[voice]);
+    const int32_t volume_ramp = jar_xm_TO_Q15(ctx->volume_ramp);
+    const int32_t panning_ramp = jar_xm_TO_Q15(ctx->panning_ramp);
+    const float* previous = ctx->channels[voice].end_of_previous_sample;
+    unsigned long frame_count = vc->frame_count[voice];
+
+    /* Frames fading from the previous sample or moving the volume */
+    for(; i < played && (frame_count < jar_xm_SAMPLE_RAMPING_POINTS || volume != target_volume || panning != target_panning); ++i, ++frame_count) {
+        int32_t point = points[i];
+
+        if(frame_count < jar_xm_SAMPLE_RAMPING_POINTS) {
+            const int32_t from = jar_xm_TO_Q15(previous[frame_count]);
+            point = from + (point - from) * (int32_t)frame_count / jar_xm_SAMPLE_RAMPING_POINTS;
+        }
+
+        if(audible) {
+            output[2 * i] += (point * ((volume * (32768 - panning)) >> 15)) >> 15;
+            output[2 * i + 1] += (point * ((volume * panning) >> 15)) >> 15;
+        }
+
+        jar_xm_SLIDE_TOWARDS(volume, target_volume, volume_ramp);
+        jar_xm_SLIDE_TOWARDS(panning, target_panning, panning_ramp);
     }
+
+    vc->frame_count[voice] = frame_count + (played - i);
+    vc->volume[voice] = (volume == target_volume) ? vc->target_volume[voice] : (float)volume / 32768.f;
+    vc->panning[voice] = (panning == target_panning) ? vc->target_panning[voice] : (float)panning / 32768.f;
 #endif
+
+    if(audible) {
+        const int32_t left = (volume * (32768 - panning)) >> 15;
+        const int32_t right = (volume * panning) >> 15;
+
+        for(; i < played; ++i) {
+            output[2 * i] += (points[i] * left) >> 15;
+            output[2 * i + 1] += (points[i] * right) >> 15;
+        }
+    }
 }
+#endif
 
 void jar_xm_generate_samples(jar_xm_context_t* ctx, float* output, size_t numsamples) {
     if(ctx && output) {
         ctx->generated_samples += numsamples;
-        for(size_t i = 0; i < numsamples; i++) {
-            jar_xm_sample(ctx, output + (2 * i), output + (2 * i + 1));
+        jar_xm_load_voices(ctx);
+
+        while(numsamples > 0) {
+            if(ctx->remaining_samples_in_tick <= 0) {
+                jar_xm_store_voices(ctx);
+                jar_xm_tick(ctx);
+                jar_xm_load_voices(ctx);
+            }
+
+            /* Frames until the next tick, the remainder drops by one per frame */
+            size_t run = (size_t)ceilf(ctx->remaining_samples_in_tick);
+            if(run < 1) run = 1;
+            if(run > numsamples) run = numsamples;
+
+            ctx->remaining_samples_in_tick -= run;
+            memset(output, 0, 2 * run * sizeof(float));
+
+            if(ctx->max_loop_count == 0 || ctx->loop_count < ctx->max_loop_count) {
+                const float fgvol = ctx->global_volume * ctx->amplification;
+
+#if JAR_XM_FIXED_POINT
+                const float scale = fgvol / 32768.f;
+                int32_t mix[2 * jar_xm_SPAN_POINTS];
+
+                for(size_t done = 0; done < run; ) {
+                    const size_t span = (run - done < jar_xm_SPAN_POINTS) ? run - done : jar_xm_SPAN_POINTS;
+
+                    memset(mix, 0, 2 * span * sizeof(int32_t));
+                    for(uint8_t i = 0; i < ctx->module.num_channels; ++i) {
+                        jar_xm_render_voice_q15(ctx, i, mix, span);
+                    }
+
+                    for(size_t i = 0; i < 2 * span; ++i) {
+                        output[2 * done + i] = (float)mix[i] * scale;
+                    }
+                    done += span;
+                }
+#else
+                for(size_t done = 0; done < run; ) {
+                    const size_t span = (run - done < jar_xm_SPAN_POINTS) ? run - done : jar_xm_SPAN_POINTS;
+                    jar_xm_render_voices(ctx, output + 2 * done, span);
+                    done += span;
+                }
+
+                for(size_t i = 0; i < 2 * run; ++i) {
+                    output[i] *= fgvol;
+                }
+#endif
+            }
+
+            output += 2 * run;
+            numsamples -= run;
+        }
+
+        jar_xm_store_voices(ctx);
+    }
+}
+
+static void jar_xm_skip_of_sample(jar_xm_channel_context_t* ch, size_t numsamples) {
+    jar_xm_sample_t* smp = ch->sample;
+    float distance = ch->step * (float)numsamples;
+
+    if(smp->length == 0) {
+        return;
+    }
+
+    if(smp->loop_type == jar_xm_FORWARD_LOOP && smp->loop_length > 0) {
+        ch->sample_position += distance;
+        if(ch->sample_position >= smp->loop_end) {
+            ch->sample_position = smp->loop_start + fmodf(ch->sample_position - smp->loop_start, (float)smp->loop_length);
+        }
+    } else if(smp->loop_type == jar_xm_PING_PONG_LOOP && smp->loop_length > 0) {
+        /* Bounce between loop_start and loop_end, whole round trips are dropped at the first bounce */
+        while(distance > 0.f) {
+            if(ch->ping) {
+                float run = smp->loop_end - ch->sample_position;
+                if(distance < run) {
+                    ch->sample_position += distance;
+                    break;
+                }
+                distance -= run;
+                ch->sample_position = smp->loop_end;
+                ch->ping = false;
+                distance = fmodf(distance, (float)(smp->loop_length << 1));
+            } else {
+                float run = ch->sample_position - smp->loop_start;
+                if(distance < run) {
+                    ch->sample_position -= distance;
+                    break;
+                }
+                distance -= run;
+                ch->sample_position = smp->loop_start;
+                ch->ping = true;
+            }
+        }
+    } else {
+        ch->sample_position += distance;
+        if(ch->sample_position >= smp->length) {
+            ch->sample_position = -1;
         }
     }
 }
 
+void jar_xm_skip_samples(jar_xm_context_t* ctx, size_t numsamples) {
+    ctx->generated_samples += numsamples;
+
+    while(numsamples > 0) {
+        if(ctx->remaining_samples_in_tick <= 0) {
+            jar_xm_tick(ctx);
+        }
+
+        /* Ticks come once the remainder drops to 0 or below, as in jar_xm_generate_samples() */
+        size_t run = (size_t)ceilf(ctx->remaining_samples_in_tick);
+        if(run < 1) run = 1;
+        if(run > numsamples) run = numsamples;
+
+        ctx->remaining_samples_in_tick -= run;
+        numsamples -= run;
+
+        if(ctx->max_loop_count > 0 && ctx->loop_count >= ctx->max_loop_count) {
+            continue;
+        }
+
+        for(uint8_t i = 0; i < ctx->module.num_channels; ++i) {
+            jar_xm_channel_context_t* ch = ctx->channels + i;
+
+            if(ch->instrument == NULL || ch->sample == NULL || ch->sample_position < 0) {
+                continue;
+            }
+
+            jar_xm_skip_of_sample(ch, run);
+
+#if JAR_XM_RAMPING
+            ch->frame_count += run;
+            jar_xm_SLIDE_TOWARDS(ch->actual_volume, ch->target_volume, ctx->volume_ramp * run);
+            jar_xm_SLIDE_TOWARDS(ch->actual_panning, ch->target_panning, ctx->panning_ramp * run);
+#endif
+        }
+    }
+}
+
+/* Playback state header, followed by one jar_xm_channel_state_t per channel */
+typedef struct jar_xm_state_s {
+    uint32_t size; /* Whole state size */
+    uint16_t num_channels;
+    uint16_t length;
+    uint16_t num_patterns;
+    uint16_t num_instruments;
+    uint32_t rate;
+    float pitch;
+
+    uint16_t tempo;
+    uint16_t bpm;
+    float global_volume;
+    uint8_t current_table_index;
+    uint8_t current_row;
+    uint16_t current_tick;
+    float remaining_samples_in_tick;
+    uint64_t generated_samples;
+    bool position_jump;
+    bool pattern_break;
+    uint8_t jump_dest;
+    uint8_t jump_row;
+    uint16_t extra_ticks;
+    uint8_t loop_count;
+} jar_xm_state_t;
+
+typedef struct jar_xm_channel_state_s {
+    jar_xm_channel_context_t ch; /* Pointers cleared, see below */
+    int32_t instrument; /* Index in module.instruments, -1 for NULL */
+    int32_t sample_instrument; /* The sample may belong to another instrument than ch.instrument */
+    int32_t sample;
+    int32_t pattern; /* Pattern of the current slot */
+    int32_t slot;
+    int64_t exact_position; /* Mixer position scaled by 2^32, see jar_xm_exact_position() */
+} jar_xm_channel_state_t;
+
+size_t jar_xm_get_state_size(jar_xm_context_t* ctx) {
+    return sizeof(jar_xm_state_t) + ctx->module.num_channels * sizeof(jar_xm_channel_state_t);
+}
+
+void jar_xm_save_state(jar_xm_context_t* ctx, void* state) {
+    jar_xm_state_t* st = (jar_xm_state_t*)state;
+    jar_xm_channel_state_t* chs = (jar_xm_channel_state_t*)(st + 1);
+
+    memset(state, 0, jar_xm_get_state_size(ctx));
+
+    st->size = (uint32_t)jar_xm_get_state_size(ctx);
+    st->num_channels = ctx->module.num_channels;
+    st->length = ctx->module.length;
+    st->num_patterns = ctx->module.num_patterns;
+    st->num_instruments = ctx->module.num_instruments;
+    st->rate = ctx->rate;
+    st->pitch = ctx->pitch;
+
+    st->tempo = ctx->tempo;
+    st->bpm = ctx->bpm;
+    st->global_volume = ctx->global_volume;
+    st->current_table_index = ctx->current_table_index;
+    st->current_row = ctx->current_row;
+    st->current_tick = ctx->current_tick;
+    st->remaining_samples_in_tick = ctx->remaining_samples_in_tick;
+    st->generated_samples = ctx->generated_samples;
+    st->position_jump = ctx->position_jump;
+    st->pattern_break = ctx->pattern_break;
+    st->jump_dest = ctx->jump_dest;
+    st->jump_row = ctx->jump_row;
+    st->extra_ticks = ctx->extra_ticks;
+    st->loop_count = ctx->loop_count;
+
+    for(uint16_t i = 0; i < ctx->module.num_channels; ++i) {
+        jar_xm_channel_context_t* ch = ctx->channels + i;
+        jar_xm_channel_state_t* cs = chs + i;
+
+        cs->ch = *ch;
+        cs->ch.instrument = NULL;
+        cs->ch.sample = NULL;
+        cs->ch.current = NULL;
+        cs->instrument = cs->sample_instrument = cs->sample = cs->pattern = cs->slot = -1;
+        cs->exact_position = ctx->voices.exact_position[i];
+
+        if(ch->instrument != NULL) {
+            cs->instrument = (int32_t)(ch->instrument - ctx->module.instruments);
+        }
+
+        for(uint16_t j = 0; ch->sample != NULL && j < ctx->module.num_instruments; ++j) {
+            jar_xm_instrument_t* instr = ctx->module.instruments + j;
+            if(ch->sample >= instr->samples && ch->sample < instr->samples + instr->num_samples) {
+                cs->sample_instrument = j;
+                cs->sample = (int32_t)(ch->sample - instr->samples);
+                break;
+            }
+        }
+
+        for(uint16_t j = 0; ch->current != NULL && j < ctx->module.num_patterns; ++j) {
+            jar_xm_pattern_t* pat = ctx->module.patterns + j;
+            if(ch->current >= pat->slots && ch->current < pat->slots + pat->num_rows * ctx->module.num_channels) {
+                cs->pattern = j;
+                cs->slot = (int32_t)(ch->current - pat->slots);
+                break;
+            }
+        }
+    }
+}
+
+/* Number of rows of the pattern at a pattern order index, 0 if there is no such pattern */
+static uint16_t jar_xm_rows_of_order(jar_xm_context_t* ctx, uint16_t table_index) {
+    if(table_index >= ctx->module.length || ctx->module.pattern_table[table_index] >= ctx->module.num_patterns) {
+        return 0;
+    }
+    return ctx->module.patterns[ctx->module.pattern_table[table_index]].num_rows;
+}
+
+/* Bytes of a state read as bool must hold 0 or 1 */
+static bool jar_xm_valid_bool(const bool* b) {
+    uint8_t v;
+    memcpy(&v, b, 1);
+    return v <= 1;
+}
+
+/* Check the indices and positions of a state against the module before
+ * any of them is used to rebuild a pointer */
+static bool jar_xm_check_state(jar_xm_context_t* ctx, const jar_xm_state_t* st) {
+    const jar_xm_channel_state_t* chs = (const jar_xm_channel_state_t*)(st + 1);
+    const jar_xm_module_t* mod = &ctx->module;
+    uint16_t rows = jar_xm_rows_of_order(ctx, st->current_table_index);
+    uint16_t dest;
+
+    if(rows == 0 || st->bpm == 0 || !isfinite(st->remaining_samples_in_tick) ||
+       !jar_xm_valid_bool(&st->position_jump) || !jar_xm_valid_bool(&st->pattern_break)) {
+        return false;
+    }
+    /* The tick remainder is rescaled from the saved rate and pitch. Runs leave it above -1 and no
+     * tick lasts an hour, anything else would stall the song or tick it on every frame */
+    if(st->rate == 0 || !(st->pitch > 0.f) || !isfinite(st->pitch) || !(st->remaining_samples_in_tick > -1.f) ||
+       !(st->remaining_samples_in_tick * ((float)ctx->rate * st->pitch) / ((float)st->rate * ctx->pitch) <= 3600.f * (float)ctx->rate)) {
+        return false;
+    }
+    /* Pending jumps leave the row past the end, it is replaced before it is read */
+    if(!st->position_jump && !st->pattern_break && st->current_row >= rows) {
+        return false;
+    }
+
+    /* jump_row is the first row read in the next pattern, see jar_xm_row() */
+    dest = st->position_jump ? st->jump_dest : st->current_table_index + 1;
+    if(dest >= mod->length) {
+        dest = mod->restart_position;
+    }
+    if(st->jump_row >= jar_xm_rows_of_order(ctx, dest)) {
+        return false;
+    }
+
+    for(uint16_t i = 0; i < mod->num_channels; ++i) {
+        const jar_xm_channel_state_t* cs = chs + i;
+
+        if(!jar_xm_valid_bool(&cs->ch.ping) || !jar_xm_valid_bool(&cs->ch.sustained) ||
+           !jar_xm_valid_bool(&cs->ch.arp_in_progress) || !jar_xm_valid_bool(&cs->ch.vibrato_in_progress) ||
+           !jar_xm_valid_bool(&cs->ch.vibrato_waveform_retrigger) || !jar_xm_valid_bool(&cs->ch.tremolo_waveform_retrigger) ||
+           !jar_xm_valid_bool(&cs->ch.tremor_on) || !jar_xm_valid_bool(&cs->ch.muted)) {
+            return false;
+        }
+
+        if(cs->instrument < -1 || cs->instrument >= mod->num_instruments) {
+            return false;
+        }
+
+        if(cs->sample_instrument != -1) {
+            const jar_xm_instrument_t* instr;
+            const jar_xm_sample_t* smp;
+
+            if(cs->sample_instrument < 0 || cs->sample_instrument >= mod->num_instruments) {
+                return false;
+            }
+            instr = mod->instruments + cs->sample_instrument;
+            if(cs->sample < 0 || cs->sample >= instr->num_samples) {
+                return false;
+            }
+            /* Negative positions are stopped samples */
+            smp = instr->samples + cs->sample;
+            if(smp->length > 0 && !(cs->ch.sample_position < (float)smp->length)) {
+                return false;
+            }
+            /* The mixer carries on from the exact position when it rounds to the restored one */
+            if((float)((double)cs->exact_position / 4294967296.) == cs->ch.sample_position &&
+               (cs->exact_position < 0 || (cs->exact_position >> 32) >= smp->length) && cs->ch.sample_position >= 0) {
+                return false;
+            }
+        }
+
+        if(cs->pattern != -1) {
+            if(cs->pattern < 0 || cs->pattern >= mod->num_patterns || cs->slot < 0 ||
+               (uint32_t)cs->slot >= (uint32_t)mod->patterns[cs->pattern].num_rows * mod->num_channels) {
+                return false;
+            }
+        }
+
+        /* E6y jumps back to the loop origin in the current pattern */
+        if(cs->ch.pattern_loop_origin >= rows) {
+            return false;
+        }
+
+        /* The Amiga octave search shifts by the distance to the base octave, keep it in range */
+        if(!(cs->ch.note > -128.f && cs->ch.note < 256.f) || cs->ch.arp_note_offset > 0xF ||
+           !(fabsf(cs->ch.vibrato_note_offset) <= 16.f) || !(fabsf(cs->ch.autovibrato_note_offset) <= 16.f) ||
+           !(cs->ch.period >= 0.f && cs->ch.period < 65536.f) ||
+           !(cs->ch.tone_portamento_target_period >= 0.f && cs->ch.tone_portamento_target_period < 65536.f)) {
+            return false;
+        }
+
+        /* The mixer steps through the sample at the restored frequency until the next tick */
+        if(!(cs->ch.frequency >= 0.f && cs->ch.frequency < 16777216.f)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int jar_xm_load_state(jar_xm_context_t* ctx, const void* state) {
+    const jar_xm_state_t* st = (const jar_xm_state_t*)state;
+    const jar_xm_channel_state_t* chs = (const jar_xm_channel_state_t*)(st + 1);
+
+    if(st->size != jar_xm_get_state_size(ctx) || st->num_channels != ctx->module.num_channels ||
+       st->length != ctx->module.length || st->num_patterns != ctx->module.num_patterns ||
+       st->num_instruments != ctx->module.num_instruments || !jar_xm_check_state(ctx, st)) {
+        return 1;
+    }
+
+    ctx->tempo = st->tempo;
+    ctx->bpm = st->bpm;
+    ctx->global_volume = st->global_volume;
+    ctx->current_table_index = st->current_table_index;
+    ctx->current_row = st->current_row;
+    ctx->current_tick = st->current_tick;
+    ctx->generated_samples = st->generated_samples;
+    ctx->position_jump = st->position_jump;
+    ctx->pattern_break = st->pattern_break;
+    ctx->jump_dest = st->jump_dest;
+    ctx->jump_row = st->jump_row;
+    ctx->extra_ticks = st->extra_ticks;
+    ctx->loop_count = st->loop_count;
+
+    /* The tick remainder is in output samples, which depend on the rate and the pitch */
+    ctx->remaining_samples_in_tick = st->remaining_samples_in_tick * ((float)ctx->rate * st->pitch) / ((float)st->rate * ctx->pitch);
+
+    for(uint16_t i = 0; i < ctx->module.num_channels; ++i) {
+        jar_xm_channel_context_t* ch = ctx->channels + i;
+        const jar_xm_channel_state_t* cs = chs + i;
+
+        *ch = cs->ch;
+        ch->instrument = (cs->instrument >= 0) ? ctx->module.instruments + cs->instrument : NULL;
+        ch->sample = (cs->sample_instrument >= 0) ? ctx->module.instruments[cs->sample_instrument].samples + cs->sample : NULL;
+        ch->current = (cs->pattern >= 0) ? ctx->module.patterns[cs->pattern].slots + cs->slot : NULL;
+        ch->step = ch->frequency * ctx->pitch / ctx->rate;
+        /* Ignored by the mixer unless it rounds to the restored position */
+        ctx->voices.exact_position[i] = cs->exact_position;
+    }
+
+    return 0;
+}
+
 uint64_t jar_xm_get_remaining_samples(jar_xm_context_t* ctx)
 {
     uint64_t total = 0;
     uint8_t currentLoopCount = jar_xm_get_loop_count(ctx);
     jar_xm_set_max_loop_count(ctx, 0);
 
-    while(jar_xm_get_loop_count(ctx) == currentLoopCount)
+    /* Same runs as jar_xm_generate_samples(), each tick lasts the frames that take its remainder to 0 or below */
+    for(;;)
     {
-        total += ctx->remaining_samples_in_tick;
-        ctx->remaining_samples_in_tick = 0;
-        jar_xm_tick(ctx);
+        if(ctx->remaining_samples_in_tick <= 0) {
+            jar_xm_tick(ctx);
+            if(jar_xm_get_loop_count(ctx) != currentLoopCount) break;
+        }
+
+        uint64_t run = (uint64_t)ceilf(ctx->remaining_samples_in_tick);
+        if(run < 1) run = 1;
+
+        ctx->remaining_samples_in_tick -= run;
+        total += run;
     }
 
     ctx->loop_count = currentLoopCount;
@@ -2605,6 +3904,26 @@ int jar_xm_create_context_from_file(jar_xm_context_t** ctx, uint32_t rate, const
     int size;
     int ret;
 
+#ifdef JAR_XM_MMAP
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    void* map = MAP_FAILED;
+
+    if(fd >= 0) {
+        if(!fstat(fd, &st) && st.st_size > 0) {
+            map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+    }
+
+    if(map != MAP_FAILED) {
+        /* The context copies everything it needs, the mapping is only read while loading */
+        ret = jar_xm_create_context_safe(ctx, (const char*)map, (size_t)st.st_size, rate);
+        munmap(map, (size_t)st.st_size);
+        goto created;
+    }
+#endif
+
     xmf = fopen(filename, "rb");
     if(xmf == NULL) {
         DEBUG_ERR("Could not open input file");
@@ -2636,6 +3955,9 @@ int jar_xm_create_context_from_file(jar_xm_context_t** ctx, uint32_t rate, const
     ret = jar_xm_create_context_safe(ctx, data, size, rate);
     free(data);
 
+#ifdef JAR_XM_MMAP
+created:
+#endif
     switch(ret) {
     case 0:
         break;
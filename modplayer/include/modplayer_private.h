@@ -8,31 +8,43 @@
 #include <regex>
 #endif
 
-#include "jc/hashtable.h"
-
-// Hash table
+// Music slots, an ID is the slot number and the generation of the slot
 struct iPod
 {
     bool is_playing;
-    Music *music;
+    Music music;            // NULL when the slot is free
+    uint32_t generation;    // Bumped when the music is unloaded, old IDs stop matching
+    uint32_t playing_index; // Position in playing_slots while is_playing
 };
-typedef jc::HashTable<uint32_t, iPod> hashtable_t;
 
-static uint32_t numelements = 10; // The maximum number of entries to store
-static uint32_t load_factor = 50; // percent
-static uint32_t tablesize = uint32_t(numelements / (load_factor / 100.0f));
-static uint32_t sizeneeded = hashtable_t::CalcSize(tablesize);
-static void *mem = malloc(sizeneeded);
-static hashtable_t ht;
-static hashtable_t::Iterator it = ht.Begin();
-static hashtable_t::Iterator itend = ht.End();
+#define SLOT_BITS 16
+#define SLOT_MASK ((1u << SLOT_BITS) - 1)
+#define GENERATION_MASK 0x7fffu // IDs stay positive Lua integers
+
+static dmArray<iPod> slots;
+static dmArray<uint32_t> free_slots;
+static dmArray<uint32_t> playing_slots; // Slots updated every frame
 
 // Music
-static Music *music;
 static iPod *vals;
-static int music_count = 0;
 static int key = 0;
 
+// Async loading, completed from UpdateModPlayer()
+struct LoadRequest
+{
+    int callback; // Lua registry references
+    int self;
+    int results;  // Table of IDs by file name for preload, LUA_NOREF for load_music_async
+    int id;       // Music of load_music_async, 0 if it failed
+    int pending;  // Files still loading
+};
+
+struct LoadJob
+{
+    LoadRequest *request;
+    char *file_name;
+};
+
 //Paths
 static const char *path;
 static const char *asset_path = "/assets/";
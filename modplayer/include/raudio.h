@@ -45,6 +45,21 @@
 //----------------------------------------------------------------------------------
 // Defines and Macros
 //----------------------------------------------------------------------------------
+// Debug hook: count heap allocations to check that steady playback never allocates
+// NOTE: Compile with RAUDIO_COUNT_ALLOCATIONS and compare GetAudioAllocationCount() before and after a number of updates.
+// Allocations made by the mixer or the render-ahead thread are counted apart and fail an assert unless NDEBUG is defined.
+#if defined(RAUDIO_COUNT_ALLOCATIONS)
+#ifndef RL_MALLOC
+#define RL_MALLOC(sz) (CountAudioAllocation(), malloc(sz))
+#endif
+#ifndef RL_CALLOC
+#define RL_CALLOC(n, sz) (CountAudioAllocation(), calloc(n, sz))
+#endif
+#ifndef RL_REALLOC
+#define RL_REALLOC(ptr, sz) (CountAudioAllocation(), realloc(ptr, sz))
+#endif
+#endif
+
 // Allow custom memory allocators
 #ifndef RL_MALLOC
 #define RL_MALLOC(sz) malloc(sz)
@@ -52,6 +67,9 @@
 #ifndef RL_CALLOC
 #define RL_CALLOC(n, sz) calloc(n, sz)
 #endif
+#ifndef RL_REALLOC
+#define RL_REALLOC(ptr, sz) realloc(ptr, sz)
+#endif
 #ifndef RL_FREE
 #define RL_FREE(p) free(p)
 #endif
@@ -71,6 +89,33 @@
 // NOTE: Anything longer than ~10 seconds should be streamed
 typedef struct MusicData *Music;
 
+// Music render modes
+typedef enum
+{
+    MUSIC_RENDER_UPDATE = 0, // Stream buffers are refilled from UpdateMusicStream() (default)
+    MUSIC_RENDER_CALLBACK,   // Frames are rendered on the audio thread when the device needs them
+    MUSIC_RENDER_THREAD      // A worker thread renders ahead into the stream ring
+} MusicRenderMode;
+
+// Music interpolation, how XM samples are resampled to the output rate
+typedef enum
+{
+    MUSIC_INTERPOLATION_NEAREST = 0, // No interpolation, cheapest and harshest
+    MUSIC_INTERPOLATION_LINEAR,      // Linear between two points (default)
+    MUSIC_INTERPOLATION_CUBIC,       // 4 point Catmull-Rom spline
+    MUSIC_INTERPOLATION_SINC         // 8 tap windowed sinc, low-passed for high notes
+} MusicInterpolation;
+
+// Wave type, defines audio wave data
+typedef struct Wave
+{
+    unsigned int sampleCount; // Total number of samples (frames * channels)
+    unsigned int sampleRate;  // Frequency (samples per second)
+    unsigned int sampleSize;  // Bit depth (bits per sample): 8, 16, 32 (24 not supported)
+    unsigned int channels;    // Number of channels (1-mono, 2-stereo)
+    void *data;               // Buffer data pointer
+} Wave;
+
 // Audio stream type
 // NOTE: Useful to create custom audio streams not bound to a specific file
 typedef struct AudioStream
@@ -100,6 +145,11 @@ extern "C"
     void SetMasterVolume(float volume); // Set master volume (listener)
 
     Music LoadMusicStream(const char *fileName); // Load music stream from file
+    Music LoadMusicStreamEx(const char *fileName, unsigned int bufferSizeInFrames, unsigned int buffers); // Load music stream from file with its own buffer geometry
+    Music LoadMusicStreamFromMemory(const unsigned char *data, unsigned int dataSize, unsigned int bufferSizeInFrames, unsigned int buffers); // Load music stream from a module in memory
+    Music LoadMusicStreamInstance(Music source, unsigned int bufferSizeInFrames, unsigned int buffers); // Load music stream sharing the module data of a loaded music
+    bool LoadMusicStreamAsync(const char *fileName, unsigned int bufferSizeInFrames, unsigned int buffers, void *userData); // Load music stream from file on the loader threads
+    bool PollMusicStreamLoad(Music *music, void **userData); // Get a music loaded by LoadMusicStreamAsync(), false if none finished
     void UnloadMusicStream(Music music);         // Unload music stream
     void PlayMusicStream(Music music);           // Start music playing
     void UpdateVolume(Music music, float volume, float amplification);
@@ -111,11 +161,27 @@ extern "C"
     void SetMusicVolume(Music music, float volume); // Set volume for music (1.0 is max level)
     void SetMusicPitch(Music music, float pitch);   // Set pitch for a music (1.0 is base level)
     void SetMusicLoopCount(Music music, int count); // Set music loop count (loop repeats)
+    void SetMusicInterpolation(Music music, int interpolation); // Set how XM samples are resampled (MusicInterpolation)
+    void SeekMusicStream(Music music, float position); // Seek music to a position (in seconds)
+    unsigned int GetMusicStateSize(Music music);     // Get the size of a music playback state
+    void SaveMusicState(Music music, void *state);   // Save the playback state of a music into GetMusicStateSize() bytes
+    bool RestoreMusicState(Music music, const void *state, unsigned int size); // Restore a playback state saved by SaveMusicState()
+    void SetMusicRenderMode(Music music, int mode); // Set where music frames are rendered (MusicRenderMode)
     float GetMusicTimeLength(Music music);          // Get music time length (in seconds)
     float GetMusicTimePlayed(Music music);          // Get current music time played (in seconds)
+    void SetMusicInfoCacheFile(const char *fileName); // Keep module lengths in a cache file, so known modules load without a full song pass
+
+    // Offline music rendering (no audio device required)
+    Wave RenderMusicWave(const char *fileName, unsigned int sampleRate, float seconds, int loops);                   // Render music into memory as stereo float frames
+    bool RenderMusicToFile(const char *fileName, const char *waveFileName, unsigned int sampleRate, float seconds, int loops); // Render music into a 16bit WAV file
+    int RenderMusicToFiles(const char **fileNames, const char **waveFileNames, int count,
+                           unsigned int sampleRate, float seconds, int loops, int threads);                       // Render a batch of musics into WAV files on worker threads
+    void UnloadWave(Wave wave);                                                                                     // Unload wave data
 
     // AudioStream management functions
     AudioStream InitAudioStream(unsigned int sampleRate, unsigned int sampleSize, unsigned int channels); // Init audio stream (to stream raw audio pcm data)
+    AudioStream InitAudioStreamEx(unsigned int sampleRate, unsigned int sampleSize, unsigned int channels,
+                                  unsigned int bufferSizeInFrames, unsigned int buffers);                 // Init audio stream with its own buffer geometry
     void UpdateAudioStream(AudioStream stream, const void *data, int samplesCount);                       // Update audio stream buffers with data
     void CloseAudioStream(AudioStream stream);                                                            // Close audio stream and free memory
     bool IsAudioBufferProcessed(AudioStream stream);                                                      // Check if any audio stream buffers requires refill
@@ -126,6 +192,14 @@ extern "C"
     void StopAudioStream(AudioStream stream);                                                             // Stop audio stream
     void SetAudioStreamVolume(AudioStream stream, float volume);                                          // Set volume for audio stream (1.0 is max level)
     void SetAudioStreamPitch(AudioStream stream, float pitch);                                            // Set pitch for audio stream (1.0 is base level)
+    void SetAudioStreamBufferPeriods(unsigned int periods);                                               // Set ring size (render-ahead depth) of new audio streams
+    void SetAudioStreamBufferSizeDefault(unsigned int size);                                              // Set buffer size (refill period) of new audio streams
+
+#if defined(RAUDIO_COUNT_ALLOCATIONS)
+    void CountAudioAllocation(void);                 // Count one allocation, called by RL_MALLOC()/RL_CALLOC()/RL_REALLOC()
+    unsigned int GetAudioAllocationCount(void);      // Get number of RL_MALLOC()/RL_CALLOC()/RL_REALLOC() allocations so far
+    unsigned int GetAudioThreadAllocationCount(void); // Get number of them made by the mixer or the render-ahead thread
+#endif
 
 #ifdef __cplusplus
 }
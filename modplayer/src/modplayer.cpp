@@ -14,6 +14,25 @@ static void patch_path()
 #endif
 }
 
+// Full path of a music file in the assets folder
+static char *music_path(const char *file_name)
+{
+    char *bundlePath = new char[strlen(path) + strlen(file_name) + 1];
+    strcpy(bundlePath, path);
+    strcat(bundlePath, file_name);
+
+#if defined(DM_PLATFORM_HTML5)
+    std::regex pattern(".*(?=\/)[/]");
+    std::string result = std::regex_replace(bundlePath, pattern, "");
+    delete[] bundlePath;
+    bundlePath = new char[result.length() + 1];
+    strcpy(bundlePath, result.c_str());
+    dmLogInfo("File for HTML: %s", bundlePath);
+#endif
+
+    return bundlePath;
+}
+
 static void null_error(const char *fn)
 {
     dmLogError(" %s: Music file is not available.", fn);
@@ -35,10 +54,50 @@ static int buildpath(lua_State *L)
     }
 }
 
+// Slot of a music ID, NULL once the music is unloaded
+static iPod *get_slot(int id)
+{
+    uint32_t slot = ((uint32_t)id & SLOT_MASK) - 1;
+
+    if (id <= 0 || slot >= slots.Size())
+        return NULL;
+
+    iPod *values = &slots[slot];
+    if (values->music == NULL || values->generation != ((uint32_t)id >> SLOT_BITS))
+        return NULL;
+
+    return values;
+}
+
 static iPod *get_vals(lua_State *L)
 {
     key = luaL_checkint(L, 1);
-    return ht.Get(key);
+    return get_slot(key);
+}
+
+// Add or remove a music from the ones updated every frame
+static void set_playing(iPod *values, bool is_playing)
+{
+    if (values->is_playing == is_playing)
+        return;
+
+    if (is_playing)
+    {
+        if (playing_slots.Full())
+            playing_slots.OffsetCapacity(16);
+
+        values->playing_index = playing_slots.Size();
+        playing_slots.Push((uint32_t)(values - slots.Begin()));
+    }
+    else
+    {
+        // The last playing music takes the free place
+        playing_slots.EraseSwap(values->playing_index);
+        if (values->playing_index < playing_slots.Size())
+            slots[playing_slots[values->playing_index]].playing_index = values->playing_index;
+    }
+
+    values->is_playing = is_playing;
 }
 
 static int xmvolume(lua_State *L)
@@ -56,11 +115,94 @@ static int xmvolume(lua_State *L)
     volume = luaL_checknumber(L, 2);
     amplification = luaL_checknumber(L, 3);
 
-    UpdateVolume(*vals->music, volume, amplification);
+    UpdateVolume(vals->music, volume, amplification);
 
     return 0;
 }
 
+// Register a loaded music and get its ID, 0 if there are no IDs left
+static int add_music(Music loaded)
+{
+    uint32_t slot;
+
+    if (!free_slots.Empty())
+    {
+        slot = free_slots.Back();
+        free_slots.Pop();
+    }
+    else
+    {
+        slot = slots.Size();
+        if (slot >= SLOT_MASK)
+        {
+            dmLogError("Too many musics loaded.");
+            UnloadMusicStream(loaded);
+            return 0;
+        }
+
+        if (slots.Full())
+            slots.OffsetCapacity(slots.Capacity() > 0 ? slots.Capacity() : 16);
+
+        iPod music_values = {false, NULL, 0, 0};
+        slots.Push(music_values);
+    }
+
+    iPod *values = &slots[slot];
+    values->is_playing = false;
+    values->music = loaded;
+
+    return (int)((values->generation << SLOT_BITS) | (slot + 1));
+}
+
+// Stop and free a music, its ID is no longer valid
+static void remove_music(int id)
+{
+    iPod *values = get_slot(id);
+
+    if (values == NULL)
+        return;
+
+    if (values->is_playing)
+    {
+        StopMusicStream(values->music);
+        set_playing(values, false);
+    }
+
+    UnloadMusicStream(values->music);
+    values->music = NULL;
+
+    // A wrapped generation would make old IDs valid again, the slot is retired instead
+    if (values->generation == GENERATION_MASK)
+        return;
+
+    values->generation++;
+
+    if (free_slots.Full())
+        free_slots.OffsetCapacity(16);
+    free_slots.Push((uint32_t)(values - slots.Begin()));
+}
+
+// Optional per music buffer geometry: { buffer_frames = 4096, buffers = 2 }
+static void music_options(lua_State *L, int index, unsigned int *buffer_frames, unsigned int *buffers)
+{
+    if (lua_istable(L, index))
+    {
+        lua_getfield(L, index, "buffer_frames");
+        if (!lua_isnil(L, -1))
+        {
+            *buffer_frames = luaL_checkint(L, -1);
+        }
+        lua_pop(L, 1);
+
+        lua_getfield(L, index, "buffers");
+        if (!lua_isnil(L, -1))
+        {
+            *buffers = luaL_checkint(L, -1);
+        }
+        lua_pop(L, 1);
+    }
+}
+
 static int unloadmusic(lua_State *L)
 {
     vals = get_vals(L);
@@ -71,15 +213,7 @@ static int unloadmusic(lua_State *L)
         return 0;
     }
 
-    if (vals->is_playing)
-    {
-        StopMusicStream(*vals->music);
-        vals->is_playing = false;
-    }
-
-    UnloadMusicStream(*vals->music);
-    delete vals->music;
-    ht.Erase(key);
+    remove_music(key);
 
     return 0;
 }
@@ -89,37 +223,234 @@ static int loadmusic(lua_State *L)
     int top = lua_gettop(L);
 
     const char *str = luaL_checkstring(L, 1);
-    char *bundlePath = new char[strlen(path) + strlen(str) + 1];
-    strcpy(bundlePath, path);
-    strcat(bundlePath, str);
+    char *bundlePath = music_path(str);
 
-#if defined(DM_PLATFORM_HTML5)
-    std::regex pattern(".*(?=\/)[/]");
-    std::string result = std::regex_replace(bundlePath, pattern, "");
-    char *cstr = new char[result.length() + 1];
-    strcpy(cstr, result.c_str());
-    bundlePath = cstr;
-    dmLogInfo("File for HTML: %s", bundlePath);
-#endif
+    unsigned int buffer_frames = 0;
+    unsigned int buffers = 0;
+    music_options(L, 2, &buffer_frames, &buffers);
+
+    Music loaded = LoadMusicStreamEx(bundlePath, buffer_frames, buffers);
+    delete[] bundlePath;
 
-    music_count++;
-    music = new Music();
-    *music = LoadMusicStream(bundlePath);
-    if (music == NULL)
+    if (loaded == NULL)
     {
-        delete music;
         return 0;
     }
+
+    lua_pushinteger(L, add_music(loaded));
+    assert(top + 1 == lua_gettop(L));
+    return 1;
+}
+
+static int loadmusicfrombuffer(lua_State *L)
+{
+    int top = lua_gettop(L);
+
+    size_t size = 0;
+    const char *data = luaL_checklstring(L, 1, &size);
+
+    unsigned int buffer_frames = 0;
+    unsigned int buffers = 0;
+    music_options(L, 2, &buffer_frames, &buffers);
+
+    // The module is read straight from the Lua string, which is only needed while loading
+    Music loaded = LoadMusicStreamFromMemory((const unsigned char *)data, (unsigned int)size, buffer_frames, buffers);
+
+    if (loaded == NULL)
+    {
+        return 0;
+    }
+
+    lua_pushinteger(L, add_music(loaded));
+    assert(top + 1 == lua_gettop(L));
+    return 1;
+}
+
+static int instancemusic(lua_State *L)
+{
+    int top = lua_gettop(L);
+
+    vals = get_vals(L);
+
+    if (vals == NULL)
+    {
+        null_error("instance_music");
+        return 0;
+    }
+
+    unsigned int buffer_frames = 0;
+    unsigned int buffers = 0;
+    music_options(L, 2, &buffer_frames, &buffers);
+
+    // Patterns and samples stay shared with the source music, even once it is unloaded
+    Music loaded = LoadMusicStreamInstance(vals->music, buffer_frames, buffers);
+
+    if (loaded == NULL)
+    {
+        return 0;
+    }
+
+    lua_pushinteger(L, add_music(loaded));
+    assert(top + 1 == lua_gettop(L));
+    return 1;
+}
+
+// Hand the loaded musics of an async load to its callback
+static void complete_load(lua_State *L, LoadRequest *request)
+{
+    int top = lua_gettop(L);
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, request->callback);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, request->self);
+    lua_pushvalue(L, -1);
+    dmScript::SetInstance(L);
+
+    if (dmScript::IsInstanceValid(L))
+    {
+        if (request->results != LUA_NOREF)
+            lua_rawgeti(L, LUA_REGISTRYINDEX, request->results);
+        else if (request->id != 0)
+            lua_pushinteger(L, request->id);
+        else
+            lua_pushnil(L);
+
+        if (lua_pcall(L, 2, 0, 0) != 0)
+        {
+            dmLogError("Error running load callback: %s", lua_tostring(L, -1));
+            lua_pop(L, 1);
+        }
+    }
     else
     {
-        iPod music_values = {false, music};
-        ht.Put(music_count, music_values);
+        // Nobody is left to use the musics
+        dmLogError("Load callback script is gone, unloading its musics.");
+        lua_pop(L, 2);
 
-        lua_pushinteger(L, music_count);
-        assert(top + 1 == lua_gettop(L));
-        return 1;
+        if (request->results != LUA_NOREF)
+        {
+            lua_rawgeti(L, LUA_REGISTRYINDEX, request->results);
+            lua_pushnil(L);
+            while (lua_next(L, -2) != 0)
+            {
+                remove_music(lua_tointeger(L, -1));
+                lua_pop(L, 1);
+            }
+            lua_pop(L, 1);
+        }
+        else if (request->id != 0)
+        {
+            remove_music(request->id);
+        }
     }
 
+    dmScript::Unref(L, LUA_REGISTRYINDEX, request->callback);
+    dmScript::Unref(L, LUA_REGISTRYINDEX, request->self);
+    if (request->results != LUA_NOREF)
+        dmScript::Unref(L, LUA_REGISTRYINDEX, request->results);
+
+    delete request;
+    assert(top == lua_gettop(L));
+}
+
+// Queue the musics of an async load, callback is at the top of the stack
+static void queue_load(lua_State *L, LoadRequest *request, const char **file_names, int count, unsigned int buffer_frames, unsigned int buffers)
+{
+    request->callback = dmScript::Ref(L, LUA_REGISTRYINDEX);
+    dmScript::GetInstance(L);
+    request->self = dmScript::Ref(L, LUA_REGISTRYINDEX);
+    request->id = 0;
+    request->pending = count;
+
+    for (int i = 0; i < count; i++)
+    {
+        LoadJob *job = new LoadJob();
+        job->request = request;
+        job->file_name = new char[strlen(file_names[i]) + 1];
+        strcpy(job->file_name, file_names[i]);
+
+        char *bundlePath = music_path(file_names[i]);
+
+        if (!LoadMusicStreamAsync(bundlePath, buffer_frames, buffers, job))
+        {
+            dmLogError("Music file could not be queued: %s", file_names[i]);
+            delete[] job->file_name;
+            delete job;
+            request->pending--;
+        }
+
+        delete[] bundlePath;
+    }
+
+    if (request->pending == 0)
+    {
+        complete_load(L, request);
+    }
+}
+
+static int loadmusicasync(lua_State *L)
+{
+    int top = lua_gettop(L);
+
+    const char *str = luaL_checkstring(L, 1);
+    int callback = lua_gettop(L) > 2 ? 3 : 2;
+    luaL_checktype(L, callback, LUA_TFUNCTION);
+
+    unsigned int buffer_frames = 0;
+    unsigned int buffers = 0;
+    if (callback == 3)
+        music_options(L, 2, &buffer_frames, &buffers);
+
+    LoadRequest *request = new LoadRequest();
+    request->results = LUA_NOREF;
+
+    lua_pushvalue(L, callback);
+    queue_load(L, request, &str, 1, buffer_frames, buffers);
+
+    assert(top == lua_gettop(L));
+    return 0;
+}
+
+static int preload(lua_State *L)
+{
+    int top = lua_gettop(L);
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    int callback = lua_gettop(L) > 2 ? 3 : 2;
+    luaL_checktype(L, callback, LUA_TFUNCTION);
+
+    unsigned int buffer_frames = 0;
+    unsigned int buffers = 0;
+    if (callback == 3)
+        music_options(L, 2, &buffer_frames, &buffers);
+
+    int count = lua_objlen(L, 1);
+
+    for (int i = 0; i < count; i++)
+    {
+        lua_rawgeti(L, 1, i + 1);
+        luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+    }
+
+    // The strings stay referenced by the table
+    const char **file_names = new const char *[count];
+
+    for (int i = 0; i < count; i++)
+    {
+        lua_rawgeti(L, 1, i + 1);
+        file_names[i] = lua_tostring(L, -1);
+        lua_pop(L, 1);
+    }
+
+    LoadRequest *request = new LoadRequest();
+    lua_newtable(L);
+    request->results = dmScript::Ref(L, LUA_REGISTRYINDEX);
+
+    lua_pushvalue(L, callback);
+    queue_load(L, request, file_names, count, buffer_frames, buffers);
+
+    delete[] file_names;
+    assert(top == lua_gettop(L));
     return 0;
 }
 
@@ -135,8 +466,8 @@ static int playmusic(lua_State *L)
 
     if (!vals->is_playing)
     {
-        PlayMusicStream(*vals->music);
-        vals->is_playing = true;
+        PlayMusicStream(vals->music);
+        set_playing(vals, true);
     }
 
     return 0;
@@ -154,8 +485,8 @@ static int stopmusic(lua_State *L)
 
     if (vals->is_playing)
     {
-        StopMusicStream(*vals->music);
-        vals->is_playing = false;
+        StopMusicStream(vals->music);
+        set_playing(vals, false);
     }
     return 0;
 }
@@ -170,7 +501,7 @@ static int resumemusic(lua_State *L)
         return 0;
     }
 
-    ResumeMusicStream(*vals->music);
+    ResumeMusicStream(vals->music);
     return 0;
 }
 
@@ -184,7 +515,7 @@ static int pausemusic(lua_State *L)
         return 0;
     }
 
-    PauseMusicStream(*vals->music);
+    PauseMusicStream(vals->music);
     return 0;
 }
 
@@ -206,7 +537,7 @@ static int musicvolume(lua_State *L)
     }
 
     double volume = luaL_checknumber(L, 2);
-    SetMusicVolume(*vals->music, volume);
+    SetMusicVolume(vals->music, volume);
     return 0;
 }
 
@@ -221,7 +552,7 @@ static int musicpitch(lua_State *L)
     }
 
     double pitch = luaL_checknumber(L, 2);
-    SetMusicPitch(*vals->music, pitch);
+    SetMusicPitch(vals->music, pitch);
     return 0;
 }
 
@@ -236,10 +567,232 @@ static int musicloop(lua_State *L)
     }
 
     int count = luaL_checkint(L, 2);
-    SetMusicLoopCount(*vals->music, count);
+    SetMusicLoopCount(vals->music, count);
+    return 0;
+}
+
+static int musicinterpolation(lua_State *L)
+{
+    vals = get_vals(L);
+
+    if (vals == NULL)
+    {
+        null_error("music_interpolation");
+        return 0;
+    }
+
+    int interpolation = luaL_checkint(L, 2);
+    SetMusicInterpolation(vals->music, interpolation);
+    return 0;
+}
+
+static int seek(lua_State *L)
+{
+    vals = get_vals(L);
+
+    if (vals == NULL)
+    {
+        null_error("seek");
+        return 0;
+    }
+
+    float position = luaL_checknumber(L, 2);
+    SeekMusicStream(vals->music, position);
+    return 0;
+}
+
+static int savestate(lua_State *L)
+{
+    vals = get_vals(L);
+
+    if (vals == NULL)
+    {
+        null_error("save_state");
+        return 0;
+    }
+
+    unsigned int size = GetMusicStateSize(vals->music);
+    char *state = new char[size];
+    SaveMusicState(vals->music, state);
+
+    lua_pushlstring(L, state, size);
+    delete[] state;
+    return 1;
+}
+
+static int restorestate(lua_State *L)
+{
+    vals = get_vals(L);
+
+    if (vals == NULL)
+    {
+        null_error("restore_state");
+        lua_pushboolean(L, false);
+        return 1;
+    }
+
+    size_t size = 0;
+    const char *state = luaL_checklstring(L, 2, &size);
+
+    lua_pushboolean(L, RestoreMusicState(vals->music, state, (unsigned int)size));
+    return 1;
+}
+
+static int rendermode(lua_State *L)
+{
+    vals = get_vals(L);
+
+    if (vals == NULL)
+    {
+        null_error("render_mode");
+        return 0;
+    }
+
+    int mode = luaL_checkint(L, 2);
+    SetMusicRenderMode(vals->music, mode);
+    return 0;
+}
+
+static int renderahead(lua_State *L)
+{
+    int periods = luaL_checkint(L, 1);
+    SetAudioStreamBufferPeriods(periods);
     return 0;
 }
 
+static int setlatency(lua_State *L)
+{
+    int buffer_frames = luaL_checkint(L, 1);
+    int buffers = luaL_optint(L, 2, 0);
+
+    if (buffer_frames < 0 || buffers < 0)
+    {
+        dmLogError("set_latency: buffer_frames and buffers cannot be negative.");
+        return 0;
+    }
+
+    SetAudioStreamBufferSizeDefault(buffer_frames);
+    if (buffers > 0)
+    {
+        SetAudioStreamBufferPeriods(buffers);
+    }
+    return 0;
+}
+
+static int cachefile(lua_State *L)
+{
+    const char *cache_path = luaL_checkstring(L, 1);
+    SetMusicInfoCacheFile(cache_path);
+    return 0;
+}
+
+static int rendertofile(lua_State *L)
+{
+    int top = lua_gettop(L);
+
+    // Optional render settings: { seconds = 0, loops = 0, sample_rate = 48000, threads = 4 }
+    double seconds = 0.0;
+    int loops = 0;
+    int sample_rate = 0;
+    int threads = 0;
+    if (lua_istable(L, 3))
+    {
+        lua_getfield(L, 3, "seconds");
+        if (!lua_isnil(L, -1))
+        {
+            seconds = luaL_checknumber(L, -1);
+        }
+        lua_pop(L, 1);
+
+        lua_getfield(L, 3, "loops");
+        if (!lua_isnil(L, -1))
+        {
+            loops = luaL_checkint(L, -1);
+        }
+        lua_pop(L, 1);
+
+        lua_getfield(L, 3, "sample_rate");
+        if (!lua_isnil(L, -1))
+        {
+            sample_rate = luaL_checkint(L, -1);
+        }
+        lua_pop(L, 1);
+
+        lua_getfield(L, 3, "threads");
+        if (!lua_isnil(L, -1))
+        {
+            threads = luaL_checkint(L, -1);
+        }
+        lua_pop(L, 1);
+    }
+
+    if (sample_rate < 0)
+    {
+        dmLogError("render_to_file: sample_rate cannot be negative.");
+        return 0;
+    }
+
+    // Single file: render_to_file("in.xm", "out.wav")
+    if (!lua_istable(L, 1))
+    {
+        const char *str = luaL_checkstring(L, 1);
+        const char *wave_path = luaL_checkstring(L, 2);
+        char *bundlePath = music_path(str);
+
+        bool rendered = RenderMusicToFile(bundlePath, wave_path, sample_rate, seconds, loops);
+        delete[] bundlePath;
+
+        lua_pushboolean(L, rendered);
+        assert(top + 1 == lua_gettop(L));
+        return 1;
+    }
+
+    // Batch: render_to_file({ "a.xm", "b.mod" }, { "a.wav", "b.wav" }), rendered in parallel
+    luaL_checktype(L, 2, LUA_TTABLE);
+    int count = lua_objlen(L, 1);
+    if (count != (int)lua_objlen(L, 2))
+    {
+        dmLogError("render_to_file: Music and wave file lists must have the same length.");
+        return 0;
+    }
+
+    const char **file_names = new const char *[count];
+    const char **wave_names = new const char *[count];
+    int names = 0;
+    for (; names < count; names++)
+    {
+        lua_rawgeti(L, 1, names + 1);
+        lua_rawgeti(L, 2, names + 1);
+        const char *str = lua_tostring(L, -2);
+        wave_names[names] = lua_tostring(L, -1); // Kept alive by the table
+        lua_pop(L, 2);
+
+        if (str == NULL || wave_names[names] == NULL)
+        {
+            dmLogError("render_to_file: File names must be strings.");
+            break;
+        }
+        file_names[names] = music_path(str);
+    }
+
+    int rendered = 0;
+    if (names == count)
+    {
+        rendered = RenderMusicToFiles(file_names, wave_names, count, sample_rate, seconds, loops, threads);
+    }
+
+    for (int i = 0; i < names; i++)
+    {
+        delete[] file_names[i];
+    }
+    delete[] file_names;
+    delete[] wave_names;
+
+    lua_pushinteger(L, rendered);
+    assert(top + 1 == lua_gettop(L));
+    return 1;
+}
+
 static int ismusicplaying(lua_State *L)
 {
     int top = lua_gettop(L);
@@ -252,7 +805,7 @@ static int ismusicplaying(lua_State *L)
     }
     else
     {
-        playing = IsMusicPlaying(*vals->music);
+        playing = IsMusicPlaying(vals->music);
     }
 
     lua_pushboolean(L, playing);
@@ -272,7 +825,7 @@ static int musiclenght(lua_State *L)
         return 0;
     }
 
-    double length = GetMusicTimeLength(*vals->music);
+    double length = GetMusicTimeLength(vals->music);
 
     lua_pushnumber(L, length);
     assert(top + 1 == lua_gettop(L));
@@ -291,7 +844,7 @@ static int musicplayed(lua_State *L)
         return 0;
     }
 
-    double length = GetMusicTimePlayed(*vals->music);
+    double length = GetMusicTimePlayed(vals->music);
 
     lua_pushnumber(L, length);
     assert(top + 1 == lua_gettop(L));
@@ -305,6 +858,15 @@ static const luaL_reg Module_methods[] =
         {"music_played", musicplayed},
         {"music_lenght", musiclenght},
         {"music_loop", musicloop},
+        {"music_interpolation", musicinterpolation},
+        {"seek", seek},
+        {"save_state", savestate},
+        {"restore_state", restorestate},
+        {"render_mode", rendermode},
+        {"render_ahead", renderahead},
+        {"set_latency", setlatency},
+        {"render_to_file", rendertofile},
+        {"cache_file", cachefile},
         {"music_pitch", musicpitch},
         {"music_volume", musicvolume},
         {"is_music_playing", ismusicplaying},
@@ -313,6 +875,10 @@ static const luaL_reg Module_methods[] =
         {"pause_music", pausemusic},
         {"play_music", playmusic},
         {"load_music", loadmusic},
+        {"load_music_async", loadmusicasync},
+        {"load_music_from_buffer", loadmusicfrombuffer},
+        {"instance_music", instancemusic},
+        {"preload", preload},
         {"unload_music", unloadmusic},
         {"master_volume", mastervolume},
         {"build_path", buildpath},
@@ -324,13 +890,27 @@ static void LuaInit(lua_State *L)
 
     luaL_register(L, MODULE_NAME, Module_methods);
 
+#define SETCONSTANT(name, value)          \
+    lua_pushnumber(L, (lua_Number)value); \
+    lua_setfield(L, -2, name);
+
+    SETCONSTANT("RENDER_UPDATE", MUSIC_RENDER_UPDATE);
+    SETCONSTANT("RENDER_CALLBACK", MUSIC_RENDER_CALLBACK);
+    SETCONSTANT("RENDER_THREAD", MUSIC_RENDER_THREAD);
+
+    SETCONSTANT("INTERPOLATION_NEAREST", MUSIC_INTERPOLATION_NEAREST);
+    SETCONSTANT("INTERPOLATION_LINEAR", MUSIC_INTERPOLATION_LINEAR);
+    SETCONSTANT("INTERPOLATION_CUBIC", MUSIC_INTERPOLATION_CUBIC);
+    SETCONSTANT("INTERPOLATION_SINC", MUSIC_INTERPOLATION_SINC);
+
+#undef SETCONSTANT
+
     lua_pop(L, 1);
     assert(top == lua_gettop(L));
 }
 
 dmExtension::Result AppInitializeModPlayer(dmExtension::AppParams *params)
 {
-    ht.Create(numelements, mem);
     InitAudioDevice();
     return dmExtension::RESULT_OK;
 }
@@ -348,14 +928,43 @@ dmExtension::Result InitializeModPlayer(dmExtension::Params *params)
 
 dmExtension::Result UpdateModPlayer(dmExtension::Params *params)
 {
-    it = ht.Begin();
-    itend = ht.End();
-    for (; it != itend; ++it)
+    lua_State *L = params->m_L;
+    Music loaded;
+    void *user_data;
+
+    while (PollMusicStreamLoad(&loaded, &user_data))
     {
-        if (it.GetValue()->is_playing)
+        LoadJob *job = (LoadJob *)user_data;
+        LoadRequest *request = job->request;
+        int id = (loaded != NULL) ? add_music(loaded) : 0;
+
+        if (request->results != LUA_NOREF)
         {
-            UpdateMusicStream(*it.GetValue()->music);
+            if (id != 0)
+            {
+                lua_rawgeti(L, LUA_REGISTRYINDEX, request->results);
+                lua_pushinteger(L, id);
+                lua_setfield(L, -2, job->file_name);
+                lua_pop(L, 1);
+            }
         }
+        else
+        {
+            request->id = id;
+        }
+
+        delete[] job->file_name;
+        delete job;
+
+        if (--request->pending == 0)
+        {
+            complete_load(L, request);
+        }
+    }
+
+    for (uint32_t i = 0; i < playing_slots.Size(); i++)
+    {
+        UpdateMusicStream(slots[playing_slots[i]].music);
     }
 
     return dmExtension::RESULT_OK;
@@ -369,7 +978,6 @@ dmExtension::Result AppFinalizeModPlayer(dmExtension::AppParams *params)
 dmExtension::Result FinalizeModPlayer(dmExtension::Params *params)
 {
     CloseAudioDevice();
-    free(mem);
     return dmExtension::RESULT_OK;
 }
 
@@ -50,6 +50,7 @@
 #include <stdlib.h> // Required for: malloc(), free()
 #include <string.h> // Required for: strcmp(), strncmp()
 #include <stdio.h>  // Required for: FILE, fopen(), fclose(), fread()
+#include <math.h>   // Required for: ceil()
 
 #define JAR_XM_IMPLEMENTATION
 #include "external/jar_xm.h" // XM loading functions
@@ -61,10 +62,49 @@
 #undef bool
 #endif
 
+// NOTE: Desktop POSIX targets map module files instead of reading them to the heap.
+// Define RAUDIO_NO_MMAP to always read them.
+#if !defined(RAUDIO_NO_MMAP) && (defined(DM_PLATFORM_LINUX) || defined(DM_PLATFORM_OSX))
+#define RAUDIO_MMAP
+#include <fcntl.h>    // Required for: open()
+#include <sys/mman.h> // Required for: mmap(), munmap()
+#include <sys/stat.h> // Required for: fstat()
+#include <unistd.h>   // Required for: close()
+#endif
+
+// NOTE: The allocation hook tells real-time threads apart with a thread local flag.
+#if defined(RAUDIO_COUNT_ALLOCATIONS)
+#include <assert.h> // Required for: assert()
+#if defined(_MSC_VER)
+#define RAUDIO_THREAD_LOCAL __declspec(thread)
+#else
+#define RAUDIO_THREAD_LOCAL __thread
+#endif
+static RAUDIO_THREAD_LOCAL bool isAudioThread = false; // Set while mixing and on the render-ahead thread
+#endif
+
+// NOTE: miniaudio is built with MA_NO_SSE2, so the mixer does its own instruction set detection.
+// Define RAUDIO_NO_SIMD to force the scalar mixing loop.
+#if !defined(RAUDIO_NO_SIMD)
+#if defined(__AVX__)
+#define RAUDIO_MIX_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RAUDIO_MIX_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__) || defined(_M_ARM64)
+#define RAUDIO_MIX_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
 //----------------------------------------------------------------------------------
 // Defines and Macros
 //----------------------------------------------------------------------------------
-#define MAX_STREAM_BUFFERS 2 // Number of buffers for each audio stream
+#define MAX_STREAM_BUFFERS 2  // Default number of buffers (periods) for each audio stream
+#define MAX_STREAM_PERIODS 64 // Maximum render-ahead depth of an audio stream, in buffers
+#define MIN_AUDIO_BUFFER_SIZE 64     // Smallest period a stream can ask for, in frames
+#define MAX_AUDIO_BUFFER_SIZE 65536  // Biggest period a stream can ask for, in frames
 
 // NOTE: Music buffer size is defined by number of samples, independent of sample size and channels number
 // After some math, considering a sampleRate of 48000, a buffer refill rate of 1/60 seconds
@@ -72,6 +112,12 @@
 // In case of music-stalls, just increase this number
 #define AUDIO_BUFFER_SIZE 4096 // PCM data samples (i.e. 16bit, Mono: 8Kb)
 
+#define MUSIC_SCRATCH_FRAMES 1024 // MOD engine renders 16bit frames through a scratch of this many stereo frames
+#define MUSIC_CHECKPOINT_SECONDS 10 // Music time between two engine states of the seek index
+#define MUSIC_STATE_MAGIC 0x5453524d // "MRST", first bytes of a saved music state
+#define MUSIC_PITCH_MIN 0.01f // Music pitch range, the engines step through samples and ticks with it
+#define MUSIC_PITCH_MAX 16.0f
+
 //----------------------------------------------------------------------------------
 // Types and Structures Definition
 //----------------------------------------------------------------------------------
@@ -90,11 +136,44 @@ typedef struct MusicData
     jar_mod_context_t ctxMod; // MOD chiptune context
     AudioStream stream;       // Audio stream (double buffering)
 
+    unsigned int sampleRate;   // Rate the engine renders at
     int loopCount;             // Loops count (times music repeats), -1 means infinite loop
     unsigned int totalSamples; // Total number of samples
     unsigned int samplesLeft;  // Number of samples left to end
+    ma_uint64 moduleHash;      // FNV-1a hash of the module file, saved states are only restored in the same module
+
+    int renderMode;              // MusicRenderMode type
+    volatile bool renderFinished; // Set by the audio thread when a callback rendered music reached its end
+
+    volatile float pitch; // Requested pitch, picked up by the renderer before the next frames
+    float enginePitch;    // Pitch the music engine currently renders at
+    float samplesFraction; // Fractional music frames played at pitch, carried between renders
+
+    // Seek index: engine states every checkpointInterval music frames, checkpoint 0 is the start of the music
+    unsigned char *checkpoints;      // Room for every checkpoint of the music, filled up as seeks go further
+    unsigned int checkpointSize;     // Size of one engine state
+    unsigned int checkpointInterval; // Music frames between two checkpoints
+    unsigned int checkpointCount;    // Checkpoints saved so far
+
+    // Scratch buffers, allocated with the music so that playback never allocates
+    float *pcm;                                 // One stream period, refilled by UpdateMusicStream()
+    short modScratch[MUSIC_SCRATCH_FRAMES * 2]; // MOD 16bit output before conversion to float
 } MusicData;
 
+// Header of a music state saved by SaveMusicState(), followed by the engine state
+typedef struct MusicStateHeader
+{
+    unsigned int magic;        // MUSIC_STATE_MAGIC
+    unsigned int ctxType;      // MusicContextType of the saved music
+    unsigned int engineSize;   // Size of the engine state
+    unsigned int sampleRate;   // Rate the position is measured in
+    unsigned int totalSamples; // Music length at sampleRate
+    unsigned int samplesLeft;  // Music frames left to the end
+    float samplesFraction;     // Fractional music frame played at pitch
+    unsigned int reserved;     // Keeps moduleHash and the engine state that follows 8 byte aligned
+    ma_uint64 moduleHash;      // Hash of the module the state was saved in
+} MusicStateHeader;
+
 typedef enum
 {
     LOG_ALL,
@@ -119,7 +198,9 @@ void TraceLog(int msgType, const char *text, ...);           // Show trace log m
 //----------------------------------------------------------------------------------
 #define DEVICE_FORMAT ma_format_f32
 #define DEVICE_CHANNELS 2
-#define DEVICE_SAMPLE_RATE 44100
+#define DEVICE_SAMPLE_RATE 0 // Use the native rate of the device, so the backend doesn't resample
+
+#define MUSIC_SAMPLE_RATE 48000 // Module rendering rate when the audio device is not available
 
 typedef enum
 {
@@ -139,11 +220,20 @@ struct rAudioBuffer
     bool paused;
     bool looping; // Always true for AudioStreams
     int usage;    // AudioBufferUsage type
-    bool isSubBufferProcessed[2];
-    unsigned int frameCursorPos;
+    bool passthrough; // Frames are already in the device format and rate, the mixer skips the converter (audio thread only)
+    volatile ma_uint32 writeFrame; // Stream ring producer cursor, wraps at twice the buffer size
+    volatile ma_uint32 readFrame;  // Stream ring consumer cursor (audio thread only)
+    unsigned int frameCursorPos;   // Static buffers only
     unsigned int bufferSizeInFrames;
-    rAudioBuffer *next;
-    rAudioBuffer *prev;
+    unsigned int periodSizeInFrames; // Streams are refilled a period at a time
+    ma_uint32 (*onRender)(void *pUserData, void *pFramesOut, ma_uint32 frameCount); // Pull-model source, used instead of the ring when set
+    void *renderUserData;
+    volatile ma_int32 renderLock; // Guards the render source, see TryLockAudioBufferRender()
+    int voiceIndex;           // Slot in the mixer voice array (audio thread only)
+    ma_uint32 playCount;      // PLAY commands posted so far (game thread only)
+    volatile ma_uint32 endedPlayCount; // playCount of the last play that ran to the end of a non looping buffer (audio thread only)
+    ma_uint32 retireEpoch;    // Mixer epoch at which the buffer was untracked
+    rAudioBuffer *nextRetired; // Retired buffers waiting to be freed (game thread only)
     unsigned char buffer[1];
 };
 
@@ -151,22 +241,102 @@ struct rAudioBuffer
 // NOTE: This system should probably be redesigned
 #define AudioBuffer rAudioBuffer
 
+// NOTE: The mixer never takes a lock. The game thread posts commands into a single-producer/single-consumer
+// queue and the audio thread applies them at the start of every callback to its own voice array.
+// The voice array is allocated by the game thread and doubled when it is full, the mixer is handed the new one by a command.
+#define AUDIO_VOICES_INITIAL_CAPACITY 64 // Voices of the first voice array
+#define AUDIO_COMMAND_QUEUE_SIZE 1024  // Pending mixer commands, must be a power of two
+
+typedef enum
+{
+    AUDIO_COMMAND_TRACK = 0,
+    AUDIO_COMMAND_UNTRACK,
+    AUDIO_COMMAND_PLAY,
+    AUDIO_COMMAND_STOP,
+    AUDIO_COMMAND_PAUSE,
+    AUDIO_COMMAND_RESUME,
+    AUDIO_COMMAND_VOLUME,
+    AUDIO_COMMAND_PITCH,
+    AUDIO_COMMAND_FLUSH,
+    AUDIO_COMMAND_GROW
+} AudioCommandType;
+
+typedef struct AudioVoiceArray AudioVoiceArray;
+
+typedef struct AudioCommand
+{
+    AudioCommandType type;
+    AudioBuffer *audioBuffer;
+    AudioVoiceArray *voices; // New voice array, GROW only
+    float value;     // Volume, pitch or rewind flag depending on the command
+    ma_uint32 frame; // Stream producer cursor when the command was posted, STOP and FLUSH drop everything before it
+} AudioCommand;
+
+// Mixer side state of a tracked audio buffer, owned by the audio thread
+typedef struct AudioVoice
+{
+    AudioBuffer *audioBuffer;
+    float volume;
+    float gain; // Gain applied at the end of the last callback, ramped towards masterVolume*volume
+    bool playing;
+    bool paused;
+    ma_uint32 playCount; // PLAY commands applied so far
+} AudioVoice;
+
+// Voice array handed to the mixer, retired and freed like audio buffers once a bigger one replaces it
+struct AudioVoiceArray
+{
+    ma_uint32 capacity;
+    ma_uint32 retireEpoch;          // Mixer epoch at which the array was replaced
+    AudioVoiceArray *nextRetired;   // Retired arrays waiting to be freed (game thread only)
+    AudioVoice voices[1];
+};
+
 // miniaudio global variables
 static ma_context context;
 static ma_device device;
-static ma_mutex audioLock;
 static bool isAudioInitialized = MA_FALSE;
 static float masterVolume = 1.0f;
 
-// Audio buffers are tracked in a linked list
-static AudioBuffer *firstAudioBuffer = NULL;
-static AudioBuffer *lastAudioBuffer = NULL;
+// Command queue (game thread -> audio thread)
+static AudioCommand audioCommands[AUDIO_COMMAND_QUEUE_SIZE];
+static volatile ma_uint32 audioCommandWrite = 0;
+static volatile ma_uint32 audioCommandRead = 0;
+
+// Voices are only touched by the audio thread
+static AudioVoiceArray *audioVoices = NULL;
+static ma_uint32 audioVoiceCount = 0;
+
+// Deferred freeing: untracked buffers and replaced voice arrays are released once the mixer has completed two callbacks
+static volatile ma_uint32 mixerEpoch = 0;
+static AudioBuffer *retiredAudioBuffers = NULL;
+static AudioVoiceArray *retiredAudioVoices = NULL;
+static AudioVoiceArray *postedAudioVoices = NULL; // Last voice array handed to the mixer (game thread only)
+static ma_uint32 trackedAudioBufferCount = 0;
+
+// Stream geometry used when a stream doesn't ask for its own
+static unsigned int streamBufferSizeInFrames = AUDIO_BUFFER_SIZE;
+static unsigned int streamBufferPeriods = MAX_STREAM_BUFFERS;
 
 // miniaudio functions declaration
 static void OnLog(ma_context *pContext, ma_device *pDevice, ma_uint32 logLevel, const char *message);
 static void OnSendAudioDataToDevice(ma_device *pDevice, void *pFramesOut, const void *pFramesInput, ma_uint32 frameCount);
 static ma_uint32 OnAudioBufferDSPRead(ma_pcm_converter *pDSP, void *pFramesOut, ma_uint32 frameCount, void *pUserData);
-static void MixAudioFrames(float *framesOut, const float *framesIn, ma_uint32 frameCount, float localVolume);
+static void MixAudioFrames(float *framesOut, const float *framesIn, ma_uint32 frameCount, ma_uint32 channels, float gainStart, float gainEnd);
+static AudioCommand *PushAudioCommand(AudioCommandType type, AudioBuffer *audioBuffer, float value);
+static void PublishAudioCommand(void);
+static void ProcessAudioCommands(void);
+static bool GrowAudioVoices(void);
+static void ReleaseRetiredAudioBuffers(bool force);
+static bool TryLockAudioBufferRender(AudioBuffer *audioBuffer);
+static void LockAudioBufferRender(AudioBuffer *audioBuffer);
+static void UnlockAudioBufferRender(AudioBuffer *audioBuffer);
+static ma_uint32 ReadAudioBufferRender(AudioBuffer *audioBuffer, void *pFramesOut, ma_uint32 frameCount);
+static ma_uint32 GetAudioBufferFramesQueued(AudioBuffer *audioBuffer);
+static void UpdateAudioBufferPassthrough(AudioBuffer *audioBuffer, float pitch);
+static void StopMusicRenderThread(void);
+static void StopMusicLoaderThreads(void);
+static Music OpenMusicStream(Music music, unsigned int bufferSizeInFrames, unsigned int buffers);
 
 // AudioBuffer management functions declaration
 // NOTE: Those functions are not exposed by raylib... for the moment
@@ -197,81 +367,149 @@ static void OnSendAudioDataToDevice(ma_device *pDevice, void *pFramesOut, const
     // This is where all of the mixing takes place.
     (void)pDevice;
 
+    ma_uint32 channels = pDevice->playback.channels;
+
     // Mixing is basically just an accumulation. We need to initialize the output buffer to 0.
-    memset(pFramesOut, 0, frameCount * pDevice->playback.channels * ma_get_bytes_per_sample(pDevice->playback.format));
+    memset(pFramesOut, 0, frameCount * channels * ma_get_bytes_per_sample(pDevice->playback.format));
+
+#if defined(RAUDIO_COUNT_ALLOCATIONS)
+    isAudioThread = true; // Web Audio mixes on the main thread, so it is cleared again at the end.
+#endif
+
+    // Apply everything the game thread asked for since the last callback. This never blocks.
+    ProcessAudioCommands();
 
-    // Using a mutex here for thread-safety which makes things not real-time. This is unlikely to be necessary for this project, but may
-    // want to consider how you might want to avoid this.
-    ma_mutex_lock(&audioLock);
+    for (ma_uint32 iVoice = 0; iVoice < audioVoiceCount; ++iVoice)
     {
-        for (AudioBuffer *audioBuffer = firstAudioBuffer; audioBuffer != NULL; audioBuffer = audioBuffer->next)
+        AudioVoice *voice = &audioVoices->voices[iVoice];
+        AudioBuffer *audioBuffer = voice->audioBuffer;
+
+        // Ignore stopped or paused sounds.
+        if (!voice->playing || voice->paused)
+            continue;
+
+        // The gain is computed once per callback. When it changed since the last one it is ramped linearly
+        // across this callback so volume changes don't click.
+        float gainStart = voice->gain;
+        float gainEnd = masterVolume * voice->volume;
+        float gainDelta = (gainEnd - gainStart) / (float)frameCount;
+        voice->gain = gainEnd;
+
+        ma_uint32 framesRead = 0;
+        for (;;)
         {
-            // Ignore stopped or paused sounds.
-            if (!audioBuffer->playing || audioBuffer->paused)
-                continue;
+            if (framesRead > frameCount)
+            {
+                TraceLog(LOG_DEBUG, "Mixed too many frames from audio buffer");
+                break;
+            }
+
+            if (framesRead == frameCount)
+                break;
 
-            ma_uint32 framesRead = 0;
-            for (;;)
+            // Just read as much data as we can from the stream.
+            ma_uint32 framesToRead = (frameCount - framesRead);
+            while (framesToRead > 0)
             {
-                if (framesRead > frameCount)
-                {
-                    TraceLog(LOG_DEBUG, "Mixed too many frames from audio buffer");
-                    break;
-                }
+                float tempBuffer[1024]; // 512 frames for stereo.
 
-                if (framesRead == frameCount)
-                    break;
+                ma_uint32 framesToReadRightNow = framesToRead;
+                ma_uint32 framesJustRead = 0;
+                const float *framesIn = tempBuffer;
+                bool fromRing = false;
 
-                // Just read as much data as we can from the stream.
-                ma_uint32 framesToRead = (frameCount - framesRead);
-                while (framesToRead > 0)
+                if (audioBuffer->passthrough && (audioBuffer->usage == AUDIO_BUFFER_USAGE_STREAM) && (audioBuffer->onRender == NULL))
                 {
-                    float tempBuffer[1024]; // 512 frames for stereo.
+                    // Stream frames are already in the device format, mix them straight from the ring.
+                    // NOTE: An underrun is reported as silent frames, streams never end.
+                    ma_uint32 framesQueued = GetAudioBufferFramesQueued(audioBuffer);
+                    ma_memory_barrier(); // Frames are published before the write cursor moves.
 
-                    ma_uint32 framesToReadRightNow = framesToRead;
-                    if (framesToReadRightNow > sizeof(tempBuffer) / sizeof(tempBuffer[0]) / DEVICE_CHANNELS)
+                    if (framesQueued > 0)
                     {
-                        framesToReadRightNow = sizeof(tempBuffer) / sizeof(tempBuffer[0]) / DEVICE_CHANNELS;
+                        ma_uint32 firstFrame = audioBuffer->readFrame % audioBuffer->bufferSizeInFrames;
+                        framesJustRead = audioBuffer->bufferSizeInFrames - firstFrame;
+                        if (framesJustRead > framesQueued)
+                            framesJustRead = framesQueued;
+                        if (framesJustRead > framesToReadRightNow)
+                            framesJustRead = framesToReadRightNow;
+
+                        framesIn = (const float *)audioBuffer->buffer + (firstFrame * channels);
+                        fromRing = true;
                     }
-
-                    ma_uint32 framesJustRead = (ma_uint32)ma_pcm_converter_read(&audioBuffer->dsp, tempBuffer, framesToReadRightNow);
-                    if (framesJustRead > 0)
+                    else
+                    {
+                        framesJustRead = framesToReadRightNow;
+                        framesIn = NULL;
+                    }
+                }
+                else
+                {
+                    if (framesToReadRightNow > sizeof(tempBuffer) / sizeof(tempBuffer[0]) / channels)
                     {
-                        float *framesOut = (float *)pFramesOut + (framesRead * device.playback.channels);
-                        float *framesIn = tempBuffer;
-                        MixAudioFrames(framesOut, framesIn, framesJustRead, audioBuffer->volume);
+                        framesToReadRightNow = sizeof(tempBuffer) / sizeof(tempBuffer[0]) / channels;
+                    }
+
+                    if (audioBuffer->passthrough)
+                        framesJustRead = OnAudioBufferDSPRead(&audioBuffer->dsp, tempBuffer, framesToReadRightNow, audioBuffer);
+                    else
+                        framesJustRead = (ma_uint32)ma_pcm_converter_read(&audioBuffer->dsp, tempBuffer, framesToReadRightNow);
+                }
 
-                        framesToRead -= framesJustRead;
-                        framesRead += framesJustRead;
+                if (framesJustRead > 0)
+                {
+                    if (framesIn != NULL)
+                    {
+                        float *framesOut = (float *)pFramesOut + (framesRead * channels);
+                        float chunkGainStart = gainStart + gainDelta * (float)framesRead;
+                        float chunkGainEnd = (gainDelta == 0.0f) ? chunkGainStart : gainStart + gainDelta * (float)(framesRead + framesJustRead);
+                        MixAudioFrames(framesOut, framesIn, framesJustRead, channels, chunkGainStart, chunkGainEnd);
                     }
 
-                    // If we weren't able to read all the frames we requested, break.
-                    if (framesJustRead < framesToReadRightNow)
+                    if (fromRing)
                     {
-                        if (!audioBuffer->looping)
-                        {
-                            StopAudioBuffer(audioBuffer);
-                            break;
-                        }
-                        else
-                        {
-                            // Should never get here, but just for safety,
-                            // move the cursor position back to the start and continue the loop.
-                            audioBuffer->frameCursorPos = 0;
-                            continue;
-                        }
+                        ma_memory_barrier(); // Done with the frames before handing them back to the producer.
+                        audioBuffer->readFrame = (audioBuffer->readFrame + framesJustRead) % (audioBuffer->bufferSizeInFrames * 2);
                     }
+
+                    framesToRead -= framesJustRead;
+                    framesRead += framesJustRead;
                 }
 
-                // If for some reason we weren't able to read every frame we'll need to break from the loop.
-                // Not doing this could theoretically put us into an infinite loop.
-                if (framesToRead > 0)
-                    break;
+                // If we weren't able to read all the frames we requested, break.
+                if (framesJustRead < framesToReadRightNow)
+                {
+                    if (!audioBuffer->looping)
+                    {
+                        voice->playing = false;
+                        voice->paused = false;
+                        audioBuffer->frameCursorPos = 0;
+                        audioBuffer->endedPlayCount = voice->playCount; // Lets IsAudioBufferPlaying() see the end
+                        break;
+                    }
+                    else
+                    {
+                        // Should never get here, but just for safety,
+                        // move the cursor position back to the start and continue the loop.
+                        audioBuffer->frameCursorPos = 0;
+                        continue;
+                    }
+                }
             }
+
+            // If for some reason we weren't able to read every frame we'll need to break from the loop.
+            // Not doing this could theoretically put us into an infinite loop.
+            if (framesToRead > 0)
+                break;
         }
     }
 
-    ma_mutex_unlock(&audioLock);
+    // Let the game thread know that every buffer untracked before this callback started is no longer referenced.
+    ma_atomic_increment_32(&mixerEpoch);
+
+#if defined(RAUDIO_COUNT_ALLOCATIONS)
+    isAudioThread = false;
+#endif
 }
 
 // DSP read from audio buffer callback function
@@ -279,77 +517,51 @@ static ma_uint32 OnAudioBufferDSPRead(ma_pcm_converter *pDSP, void *pFramesOut,
 {
     AudioBuffer *audioBuffer = (AudioBuffer *)pUserData;
 
-    ma_uint32 subBufferSizeInFrames = (audioBuffer->bufferSizeInFrames > 1) ? audioBuffer->bufferSizeInFrames / 2 : audioBuffer->bufferSizeInFrames;
-    ma_uint32 currentSubBufferIndex = audioBuffer->frameCursorPos / subBufferSizeInFrames;
-
-    if (currentSubBufferIndex > 1)
-    {
-        TraceLog(LOG_DEBUG, "Frame cursor position moved too far forward in audio stream");
-        return 0;
-    }
-
-    // Another thread can update the processed state of buffers so we just take a copy here to try and avoid potential synchronization problems.
-    bool isSubBufferProcessed[2];
-    isSubBufferProcessed[0] = audioBuffer->isSubBufferProcessed[0];
-    isSubBufferProcessed[1] = audioBuffer->isSubBufferProcessed[1];
+    // Pull-model buffers render exactly what the converter asks for, there are no sub-buffers to read.
+    if (audioBuffer->onRender != NULL)
+        return ReadAudioBufferRender(audioBuffer, pFramesOut, frameCount);
 
     ma_uint32 frameSizeInBytes = ma_get_bytes_per_sample(audioBuffer->dsp.formatConverterIn.config.formatIn) * audioBuffer->dsp.formatConverterIn.config.channels;
-
-    // Fill out every frame until we find a buffer that's marked as processed. Then fill the remainder with 0.
     ma_uint32 framesRead = 0;
-    for (;;)
+
+    if (audioBuffer->usage == AUDIO_BUFFER_USAGE_STATIC)
     {
-        // We break from this loop differently depending on the buffer's usage. For static buffers, we simply fill as much data as we can. For
-        // streaming buffers we only fill the halves of the buffer that are processed. Unprocessed halves must keep their audio data in-tact.
-        if (audioBuffer->usage == AUDIO_BUFFER_USAGE_STATIC)
+        // Static buffers simply fill as much data as they can.
+        while (framesRead < frameCount)
         {
-            if (framesRead >= frameCount)
-                break;
-        }
-        else
-        {
-            if (isSubBufferProcessed[currentSubBufferIndex])
-                break;
-        }
+            ma_uint32 framesToRead = frameCount - framesRead;
+            ma_uint32 framesRemainingInOutputBuffer = audioBuffer->bufferSizeInFrames - audioBuffer->frameCursorPos;
+            if (framesToRead > framesRemainingInOutputBuffer)
+                framesToRead = framesRemainingInOutputBuffer;
 
-        ma_uint32 totalFramesRemaining = (frameCount - framesRead);
-        if (totalFramesRemaining == 0)
-            break;
+            memcpy((unsigned char *)pFramesOut + (framesRead * frameSizeInBytes), audioBuffer->buffer + (audioBuffer->frameCursorPos * frameSizeInBytes), framesToRead * frameSizeInBytes);
+            audioBuffer->frameCursorPos = (audioBuffer->frameCursorPos + framesToRead) % audioBuffer->bufferSizeInFrames;
+            framesRead += framesToRead;
 
-        ma_uint32 framesRemainingInOutputBuffer;
-        if (audioBuffer->usage == AUDIO_BUFFER_USAGE_STATIC)
-        {
-            framesRemainingInOutputBuffer = audioBuffer->bufferSizeInFrames - audioBuffer->frameCursorPos;
-        }
-        else
-        {
-            ma_uint32 firstFrameIndexOfThisSubBuffer = subBufferSizeInFrames * currentSubBufferIndex;
-            framesRemainingInOutputBuffer = subBufferSizeInFrames - (audioBuffer->frameCursorPos - firstFrameIndexOfThisSubBuffer);
+            // We need to break from this loop if we're not looping. The mixer stops the voice when it gets less frames than requested.
+            if ((audioBuffer->frameCursorPos == 0) && !audioBuffer->looping)
+                break;
         }
+    }
+    else
+    {
+        // Streams read whatever the producer has queued in the ring.
+        ma_uint32 read = audioBuffer->readFrame;
+        ma_uint32 framesQueued = GetAudioBufferFramesQueued(audioBuffer);
+        ma_memory_barrier(); // Frames are published before the write cursor moves.
 
-        ma_uint32 framesToRead = totalFramesRemaining;
-        if (framesToRead > framesRemainingInOutputBuffer)
-            framesToRead = framesRemainingInOutputBuffer;
-
-        memcpy((unsigned char *)pFramesOut + (framesRead * frameSizeInBytes), audioBuffer->buffer + (audioBuffer->frameCursorPos * frameSizeInBytes), framesToRead * frameSizeInBytes);
-        audioBuffer->frameCursorPos = (audioBuffer->frameCursorPos + framesToRead) % audioBuffer->bufferSizeInFrames;
-        framesRead += framesToRead;
+        framesRead = (framesQueued < frameCount) ? framesQueued : frameCount;
 
-        // If we've read to the end of the buffer, mark it as processed.
-        if (framesToRead == framesRemainingInOutputBuffer)
-        {
-            audioBuffer->isSubBufferProcessed[currentSubBufferIndex] = true;
-            isSubBufferProcessed[currentSubBufferIndex] = true;
+        ma_uint32 firstFrame = read % audioBuffer->bufferSizeInFrames;
+        ma_uint32 firstPart = audioBuffer->bufferSizeInFrames - firstFrame;
+        if (firstPart > framesRead)
+            firstPart = framesRead;
 
-            currentSubBufferIndex = (currentSubBufferIndex + 1) % 2;
+        memcpy(pFramesOut, audioBuffer->buffer + (firstFrame * frameSizeInBytes), firstPart * frameSizeInBytes);
+        memcpy((unsigned char *)pFramesOut + (firstPart * frameSizeInBytes), audioBuffer->buffer, (framesRead - firstPart) * frameSizeInBytes);
 
-            // We need to break from this loop if we're not looping.
-            if (!audioBuffer->looping)
-            {
-                StopAudioBuffer(audioBuffer);
-                break;
-            }
-        }
+        ma_memory_barrier(); // Done with the frames before handing them back to the producer.
+        audioBuffer->readFrame = (read + framesRead) % (audioBuffer->bufferSizeInFrames * 2);
     }
 
     // Zero-fill excess.
@@ -360,7 +572,7 @@ static ma_uint32 OnAudioBufferDSPRead(ma_pcm_converter *pDSP, void *pFramesOut,
 
         // For static buffers we can fill the remaining frames with silence for safety, but we don't want
         // to report those frames as "read". The reason for this is that the caller uses the return value
-        // to know whether or not a non-looping sound has finished playback.
+        // to know whether or not a non-looping sound has finished playback. Streams just underrun.
         if (audioBuffer->usage != AUDIO_BUFFER_USAGE_STATIC)
             framesRead += totalFramesRemaining;
     }
@@ -368,687 +580,2805 @@ static ma_uint32 OnAudioBufferDSPRead(ma_pcm_converter *pDSP, void *pFramesOut,
     return framesRead;
 }
 
-// This is the main mixing function. Mixing is pretty simple in this project - it's just an accumulation.
-// NOTE: framesOut is both an input and an output. It will be initially filled with zeros outside of this function.
-static void MixAudioFrames(float *framesOut, const float *framesIn, ma_uint32 frameCount, float localVolume)
+// Number of frames waiting in the ring of a stream
+// NOTE: Cursors wrap at twice the buffer size so a full ring can be told apart from an empty one
+static ma_uint32 GetAudioBufferFramesQueued(AudioBuffer *audioBuffer)
 {
-    for (ma_uint32 iFrame = 0; iFrame < frameCount; ++iFrame)
-    {
-        for (ma_uint32 iChannel = 0; iChannel < device.playback.channels; ++iChannel)
-        {
-            float *frameOut = framesOut + (iFrame * device.playback.channels);
-            const float *frameIn = framesIn + (iFrame * device.playback.channels);
+    ma_uint32 write = audioBuffer->writeFrame;
+    ma_uint32 read = audioBuffer->readFrame;
 
-            frameOut[iChannel] += (frameIn[iChannel] * masterVolume * localVolume);
-        }
-    }
+    return (write >= read) ? (write - read) : (write + (audioBuffer->bufferSizeInFrames * 2) - read);
 }
 
-//----------------------------------------------------------------------------------
-// Module Functions Definition - Audio Device initialization and Closing
-//----------------------------------------------------------------------------------
-// Initialize audio device
-void InitAudioDevice(void)
+// Drop queued stream frames up to the given producer cursor (audio thread only)
+static void FlushAudioBuffer(AudioBuffer *audioBuffer, ma_uint32 frame)
 {
-    // Context.
-    ma_context_config contextConfig = ma_context_config_init();
-    contextConfig.logCallback = OnLog;
-    ma_result result = ma_context_init(NULL, 0, &contextConfig, &context);
-    if (result != MA_SUCCESS)
-    {
-        TraceLog(LOG_ERROR, "Failed to initialize audio context");
+    if (audioBuffer->usage != AUDIO_BUFFER_USAGE_STREAM)
         return;
-    }
 
-    // Device. Using the default device. Format is floating point because it simplifies mixing.
-    ma_device_config config = ma_device_config_init(ma_device_type_playback);
-    config.playback.pDeviceID = NULL; // NULL for the default playback device.
-    config.playback.format = DEVICE_FORMAT;
-    config.playback.channels = DEVICE_CHANNELS;
-    config.capture.pDeviceID = NULL; // NULL for the default capture device.
-    config.capture.format = ma_format_s16;
-    config.capture.channels = 1;
-    config.sampleRate = DEVICE_SAMPLE_RATE;
-    config.dataCallback = OnSendAudioDataToDevice;
-    config.pUserData = NULL;
+    ma_uint32 read = audioBuffer->readFrame;
+    ma_uint32 framesToFlush = (frame >= read) ? (frame - read) : (frame + (audioBuffer->bufferSizeInFrames * 2) - read);
 
-    result = ma_device_init(&context, &config, &device);
-    if (result != MA_SUCCESS)
-    {
-        TraceLog(LOG_ERROR, "Failed to initialize audio playback device");
-        ma_context_uninit(&context);
-        return;
-    }
+    // The mixer may already have played past the flush point, in which case there is nothing left to drop.
+    if (framesToFlush <= GetAudioBufferFramesQueued(audioBuffer))
+        audioBuffer->readFrame = frame;
+}
 
-    // Keep the device running the whole time. May want to consider doing something a bit smarter and only have the device running
-    // while there's at least one sound being played.
-    result = ma_device_start(&device);
-    if (result != MA_SUCCESS)
+// Read frames from the render source of an audio buffer (audio thread only)
+// NOTE: Never waits. If the game thread is holding the source the frames are silent, but still reported as read.
+static ma_uint32 ReadAudioBufferRender(AudioBuffer *audioBuffer, void *pFramesOut, ma_uint32 frameCount)
+{
+    ma_uint32 framesRead = 0;
+
+    if (TryLockAudioBufferRender(audioBuffer))
     {
-        TraceLog(LOG_ERROR, "Failed to start audio playback device");
-        ma_device_uninit(&device);
-        ma_context_uninit(&context);
-        return;
+        if (audioBuffer->onRender != NULL)
+            framesRead = audioBuffer->onRender(audioBuffer->renderUserData, pFramesOut, frameCount);
+
+        UnlockAudioBufferRender(audioBuffer);
     }
 
-    // Mixing happens on a seperate thread which means we need to synchronize. I'm using a mutex here to make things simple, but may
-    // want to look at something a bit smarter later on to keep everything real-time, if that's necessary.
-    if (ma_mutex_init(&context, &audioLock) != MA_SUCCESS)
+    if (framesRead < frameCount)
     {
-        TraceLog(LOG_ERROR, "Failed to create mutex for audio mixing");
-        ma_device_uninit(&device);
-        ma_context_uninit(&context);
-        return;
+        ma_uint32 frameSizeInBytes = ma_get_bytes_per_sample(audioBuffer->dsp.formatConverterIn.config.formatIn) * audioBuffer->dsp.formatConverterIn.config.channels;
+        memset((unsigned char *)pFramesOut + (framesRead * frameSizeInBytes), 0, (frameCount - framesRead) * frameSizeInBytes);
     }
 
-    TraceLog(LOG_INFO, "Audio device initialized successfully");
-    TraceLog(LOG_INFO, "Audio backend: miniaudio / %s", ma_get_backend_name(context.backend));
-    TraceLog(LOG_INFO, "Audio format: %s -> %s", ma_get_format_name(device.playback.format), ma_get_format_name(device.playback.internalFormat));
-    TraceLog(LOG_INFO, "Audio channels: %d -> %d", device.playback.channels, device.playback.internalChannels);
-    TraceLog(LOG_INFO, "Audio sample rate: %d -> %d", device.sampleRate, device.playback.internalSampleRate);
-    TraceLog(LOG_INFO, "Audio buffer size: %d", device.playback.internalBufferSizeInFrames);
-
-    isAudioInitialized = MA_TRUE;
+    return frameCount;
 }
 
-// Close the audio device for all contexts
-void CloseAudioDevice(void)
+// Accumulate interleaved samples with a constant gain
+static void MixSamples(float *samplesOut, const float *samplesIn, ma_uint32 sampleCount, float gain)
 {
-    if (!isAudioInitialized)
+    ma_uint32 iSample = 0;
+
+#if defined(RAUDIO_MIX_AVX)
+    __m256 gain8 = _mm256_set1_ps(gain);
+    for (; iSample + 8 <= sampleCount; iSample += 8)
     {
-        TraceLog(LOG_WARNING, "Could not close audio device because it is not currently initialized");
-        return;
+        __m256 out = _mm256_loadu_ps(samplesOut + iSample);
+        out = _mm256_add_ps(out, _mm256_mul_ps(_mm256_loadu_ps(samplesIn + iSample), gain8));
+        _mm256_storeu_ps(samplesOut + iSample, out);
     }
+#elif defined(RAUDIO_MIX_SSE2)
+    __m128 gain4 = _mm_set1_ps(gain);
+    for (; iSample + 4 <= sampleCount; iSample += 4)
+    {
+        __m128 out = _mm_loadu_ps(samplesOut + iSample);
+        out = _mm_add_ps(out, _mm_mul_ps(_mm_loadu_ps(samplesIn + iSample), gain4));
+        _mm_storeu_ps(samplesOut + iSample, out);
+    }
+#elif defined(RAUDIO_MIX_NEON)
+    float32x4_t gain4 = vdupq_n_f32(gain);
+    for (; iSample + 4 <= sampleCount; iSample += 4)
+    {
+        float32x4_t out = vld1q_f32(samplesOut + iSample);
+        out = vmlaq_f32(out, vld1q_f32(samplesIn + iSample), gain4);
+        vst1q_f32(samplesOut + iSample, out);
+    }
+#endif
 
-    ma_mutex_uninit(&audioLock);
-    ma_device_uninit(&device);
-    ma_context_uninit(&context);
-
-    TraceLog(LOG_INFO, "Audio device closed successfully");
+    for (; iSample < sampleCount; ++iSample)
+        samplesOut[iSample] += samplesIn[iSample] * gain;
 }
 
-// Check if device has been initialized successfully
-bool IsAudioDeviceReady(void)
+// Accumulate interleaved stereo frames with a gain that moves by gainStep every frame
+static void MixStereoFramesRamp(float *framesOut, const float *framesIn, ma_uint32 frameCount, float gain, float gainStep)
 {
-    return isAudioInitialized;
-}
+    ma_uint32 iFrame = 0;
 
-// Set master volume (listener)
-void SetMasterVolume(float volume)
-{
-    if (volume < 0.0f)
-        volume = 0.0f;
-    else if (volume > 1.0f)
-        volume = 1.0f;
+#if defined(RAUDIO_MIX_AVX)
+    __m256 gain8 = _mm256_setr_ps(gain, gain, gain + gainStep, gain + gainStep,
+                                  gain + 2.0f * gainStep, gain + 2.0f * gainStep, gain + 3.0f * gainStep, gain + 3.0f * gainStep);
+    __m256 step8 = _mm256_set1_ps(4.0f * gainStep);
+    for (; iFrame + 4 <= frameCount; iFrame += 4)
+    {
+        __m256 out = _mm256_loadu_ps(framesOut + iFrame * 2);
+        out = _mm256_add_ps(out, _mm256_mul_ps(_mm256_loadu_ps(framesIn + iFrame * 2), gain8));
+        _mm256_storeu_ps(framesOut + iFrame * 2, out);
+        gain8 = _mm256_add_ps(gain8, step8);
+    }
+#elif defined(RAUDIO_MIX_SSE2)
+    __m128 gain4 = _mm_setr_ps(gain, gain, gain + gainStep, gain + gainStep);
+    __m128 step4 = _mm_set1_ps(2.0f * gainStep);
+    for (; iFrame + 2 <= frameCount; iFrame += 2)
+    {
+        __m128 out = _mm_loadu_ps(framesOut + iFrame * 2);
+        out = _mm_add_ps(out, _mm_mul_ps(_mm_loadu_ps(framesIn + iFrame * 2), gain4));
+        _mm_storeu_ps(framesOut + iFrame * 2, out);
+        gain4 = _mm_add_ps(gain4, step4);
+    }
+#elif defined(RAUDIO_MIX_NEON)
+    float gains[4] = {gain, gain, gain + gainStep, gain + gainStep};
+    float32x4_t gain4 = vld1q_f32(gains);
+    float32x4_t step4 = vdupq_n_f32(2.0f * gainStep);
+    for (; iFrame + 2 <= frameCount; iFrame += 2)
+    {
+        float32x4_t out = vld1q_f32(framesOut + iFrame * 2);
+        out = vmlaq_f32(out, vld1q_f32(framesIn + iFrame * 2), gain4);
+        vst1q_f32(framesOut + iFrame * 2, out);
+        gain4 = vaddq_f32(gain4, step4);
+    }
+#endif
 
-    masterVolume = volume;
+    for (; iFrame < frameCount; ++iFrame)
+    {
+        float frameGain = gain + gainStep * (float)iFrame;
+        framesOut[iFrame * 2 + 0] += framesIn[iFrame * 2 + 0] * frameGain;
+        framesOut[iFrame * 2 + 1] += framesIn[iFrame * 2 + 1] * frameGain;
+    }
 }
 
-//----------------------------------------------------------------------------------
-// Module Functions Definition - Audio Buffer management
-//----------------------------------------------------------------------------------
-
-// Create a new audio buffer. Initially filled with silence
-AudioBuffer *CreateAudioBuffer(ma_format format, ma_uint32 channels, ma_uint32 sampleRate, ma_uint32 bufferSizeInFrames, AudioBufferUsage usage)
+// This is the main mixing function. Mixing is pretty simple in this project - it's just an accumulation.
+// The gain moves linearly from gainStart to gainEnd over the frames, the common constant gain case skips the ramp.
+// NOTE: framesOut is both an input and an output. It will be initially filled with zeros outside of this function.
+static void MixAudioFrames(float *framesOut, const float *framesIn, ma_uint32 frameCount, ma_uint32 channels, float gainStart, float gainEnd)
 {
-    AudioBuffer *audioBuffer = (AudioBuffer *)RL_CALLOC(sizeof(*audioBuffer) + (bufferSizeInFrames * channels * ma_get_bytes_per_sample(format)), 1);
-    if (audioBuffer == NULL)
+    if (frameCount == 0)
+        return;
+
+    if (gainStart == gainEnd)
     {
-        TraceLog(LOG_ERROR, "CreateAudioBuffer() : Failed to allocate memory for audio buffer");
-        return NULL;
+        MixSamples(framesOut, framesIn, frameCount * channels, gainStart);
+        return;
     }
 
-    // We run audio data through a format converter.
-    ma_pcm_converter_config dspConfig;
-    memset(&dspConfig, 0, sizeof(dspConfig));
-    dspConfig.formatIn = format;
-    dspConfig.formatOut = DEVICE_FORMAT;
-    dspConfig.channelsIn = channels;
-    dspConfig.channelsOut = DEVICE_CHANNELS;
-    dspConfig.sampleRateIn = sampleRate;
-    dspConfig.sampleRateOut = DEVICE_SAMPLE_RATE;
-    dspConfig.onRead = OnAudioBufferDSPRead;
-    dspConfig.pUserData = audioBuffer;
-    dspConfig.allowDynamicSampleRate = MA_TRUE; // <-- Required for pitch shifting.
-    ma_result result = ma_pcm_converter_init(&dspConfig, &audioBuffer->dsp);
+    float gainStep = (gainEnd - gainStart) / (float)frameCount;
 
-    if (result != MA_SUCCESS)
+    if (channels == 2)
     {
-        TraceLog(LOG_ERROR, "CreateAudioBuffer() : Failed to create data conversion pipeline");
-        RL_FREE(audioBuffer);
-        return NULL;
+        MixStereoFramesRamp(framesOut, framesIn, frameCount, gainStart, gainStep);
+        return;
     }
 
-    audioBuffer->volume = 1.0f;
-    audioBuffer->pitch = 1.0f;
-    audioBuffer->playing = false;
-    audioBuffer->paused = false;
-    audioBuffer->looping = false;
-    audioBuffer->usage = usage;
-    audioBuffer->bufferSizeInFrames = bufferSizeInFrames;
-    audioBuffer->frameCursorPos = 0;
-
-    // Buffers should be marked as processed by default so that a call to UpdateAudioStream() immediately after initialization works correctly.
-    audioBuffer->isSubBufferProcessed[0] = true;
-    audioBuffer->isSubBufferProcessed[1] = true;
-
-    TrackAudioBuffer(audioBuffer);
-
-    return audioBuffer;
+    for (ma_uint32 iFrame = 0; iFrame < frameCount; ++iFrame)
+    {
+        float frameGain = gainStart + gainStep * (float)iFrame;
+        for (ma_uint32 iChannel = 0; iChannel < channels; ++iChannel)
+            framesOut[iFrame * channels + iChannel] += framesIn[iFrame * channels + iChannel] * frameGain;
+    }
 }
 
-// Delete an audio buffer
-void DeleteAudioBuffer(AudioBuffer *audioBuffer)
+// Post a command to the mixer (game thread only)
+// NOTE: Only waits when the queue is full, which means the audio thread has not run for a long time.
+static AudioCommand *PushAudioCommand(AudioCommandType type, AudioBuffer *audioBuffer, float value)
 {
-    if (audioBuffer == NULL)
+    // Counted even without a mixer, so a buffer played then never reports an end.
+    if (type == AUDIO_COMMAND_PLAY)
+        audioBuffer->playCount++;
+
+    if (!isAudioInitialized)
+        return NULL;
+
+    ma_uint32 write = audioCommandWrite;
+    while ((write - audioCommandRead) >= AUDIO_COMMAND_QUEUE_SIZE)
     {
-        TraceLog(LOG_ERROR, "DeleteAudioBuffer() : No audio buffer");
-        return;
+#if defined(MA_EMSCRIPTEN)
+        ProcessAudioCommands(); // Web Audio mixes on this thread, so there is no one else to drain the queue.
+#else
+        ma_sleep(1);
+#endif
     }
 
-    UntrackAudioBuffer(audioBuffer);
-    RL_FREE(audioBuffer);
+    AudioCommand *command = &audioCommands[write & (AUDIO_COMMAND_QUEUE_SIZE - 1)];
+    command->type = type;
+    command->audioBuffer = audioBuffer;
+    command->voices = NULL;
+    command->value = value;
+    command->frame = (audioBuffer != NULL) ? audioBuffer->writeFrame : 0;
+
+    // GROW fills in its array before publishing.
+    if (type != AUDIO_COMMAND_GROW)
+        PublishAudioCommand();
+
+    return command;
 }
 
-// Check if an audio buffer is playing
-bool IsAudioBufferPlaying(AudioBuffer *audioBuffer)
+// Move the write index past the last pushed command (game thread only)
+static void PublishAudioCommand(void)
 {
-    if (audioBuffer == NULL)
-    {
+    ma_memory_barrier(); // Publish the command before moving the write index.
+    audioCommandWrite = audioCommandWrite + 1;
+}
+
+// Apply pending commands to the voice array (audio thread only)
+static void ProcessAudioCommands(void)
+{
+    ma_uint32 read = audioCommandRead;
+    ma_uint32 write = audioCommandWrite;
+    ma_memory_barrier();
+
+    for (; read != write; ++read)
+    {
+        AudioCommand *command = &audioCommands[read & (AUDIO_COMMAND_QUEUE_SIZE - 1)];
+        AudioBuffer *audioBuffer = command->audioBuffer;
+
+        if (command->type == AUDIO_COMMAND_GROW)
+        {
+            // The old array stays valid until the game thread sees two more callbacks complete.
+            if (audioVoiceCount > 0)
+                memcpy(command->voices->voices, audioVoices->voices, audioVoiceCount * sizeof(AudioVoice));
+            audioVoices = command->voices;
+            continue;
+        }
+
+        if (command->type == AUDIO_COMMAND_TRACK)
+        {
+            // The game thread grows the array before it tracks more buffers than it holds.
+            AudioVoice *voice = &audioVoices->voices[audioVoiceCount];
+            voice->audioBuffer = audioBuffer;
+            voice->volume = audioBuffer->volume;
+            voice->gain = masterVolume * audioBuffer->volume;
+            voice->playing = false;
+            voice->paused = false;
+            voice->playCount = 0;
+            audioBuffer->voiceIndex = (int)audioVoiceCount;
+            UpdateAudioBufferPassthrough(audioBuffer, audioBuffer->pitch);
+            audioVoiceCount++;
+            continue;
+        }
+
+        if (audioBuffer->voiceIndex < 0)
+            continue;
+
+        AudioVoice *voice = &audioVoices->voices[audioBuffer->voiceIndex];
+
+        switch (command->type)
+        {
+        case AUDIO_COMMAND_UNTRACK:
+        {
+            // Swap with the last voice to keep the array dense.
+            audioVoiceCount--;
+            if ((ma_uint32)audioBuffer->voiceIndex != audioVoiceCount)
+            {
+                *voice = audioVoices->voices[audioVoiceCount];
+                voice->audioBuffer->voiceIndex = audioBuffer->voiceIndex;
+            }
+            audioBuffer->voiceIndex = -1;
+        }
+        break;
+
+        case AUDIO_COMMAND_PLAY:
+            if (!voice->playing)
+                voice->gain = masterVolume * voice->volume; // Start at the target gain instead of ramping from stale state
+            voice->playCount++;
+            voice->playing = true;
+            voice->paused = false;
+            if (command->value != 0.0f)
+                audioBuffer->frameCursorPos = 0;
+            break;
+
+        case AUDIO_COMMAND_STOP:
+            voice->playing = false;
+            voice->paused = false;
+            audioBuffer->frameCursorPos = 0;
+            FlushAudioBuffer(audioBuffer, command->frame);
+            break;
+
+        case AUDIO_COMMAND_FLUSH:
+            FlushAudioBuffer(audioBuffer, command->frame);
+            break;
+
+        case AUDIO_COMMAND_PAUSE:
+            voice->paused = true;
+            break;
+
+        case AUDIO_COMMAND_RESUME:
+            voice->paused = false;
+            break;
+
+        case AUDIO_COMMAND_VOLUME:
+            voice->volume = command->value;
+            break;
+
+        case AUDIO_COMMAND_PITCH:
+            // Pitching is just an adjustment of the sample rate. Note that this changes the duration of the sound - higher pitches
+            // will make the sound faster; lower pitches make it slower.
+            ma_pcm_converter_set_output_sample_rate(&audioBuffer->dsp, (ma_uint32)((float)device.sampleRate / command->value));
+            UpdateAudioBufferPassthrough(audioBuffer, command->value);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    ma_memory_barrier(); // Done reading the slots before handing them back.
+    audioCommandRead = read;
+}
+
+// Check whether the mixer can skip the converter of an audio buffer (audio thread only)
+static void UpdateAudioBufferPassthrough(AudioBuffer *audioBuffer, float pitch)
+{
+    audioBuffer->passthrough = (audioBuffer->dsp.formatConverterIn.config.formatIn == ma_format_f32) &&
+                               (audioBuffer->dsp.formatConverterIn.config.channels == device.playback.channels) &&
+                               (audioBuffer->dsp.src.config.sampleRateIn == device.sampleRate) &&
+                               (pitch == 1.0f);
+}
+
+// Hand the mixer a voice array twice as big as the current one (game thread only)
+static bool GrowAudioVoices(void)
+{
+    ma_uint32 capacity = (postedAudioVoices == NULL) ? AUDIO_VOICES_INITIAL_CAPACITY : (postedAudioVoices->capacity * 2);
+    AudioVoiceArray *voices = (AudioVoiceArray *)RL_CALLOC(sizeof(AudioVoiceArray) + (capacity - 1) * sizeof(AudioVoice), 1);
+
+    if (voices == NULL)
+    {
+        TraceLog(LOG_ERROR, "GrowAudioVoices() : Failed to allocate memory for %i audio voices", capacity);
+        return false;
+    }
+
+    voices->capacity = capacity;
+
+    AudioCommand *command = PushAudioCommand(AUDIO_COMMAND_GROW, NULL, 0.0f);
+    command->voices = voices;
+    PublishAudioCommand();
+
+    if (postedAudioVoices != NULL)
+    {
+        postedAudioVoices->retireEpoch = mixerEpoch;
+        postedAudioVoices->nextRetired = retiredAudioVoices;
+        retiredAudioVoices = postedAudioVoices;
+    }
+    postedAudioVoices = voices;
+
+    return true;
+}
+
+// Free retired audio buffers and voice arrays the mixer can no longer reference (game thread only)
+static void ReleaseRetiredAudioBuffers(bool force)
+{
+    ma_uint32 epoch = mixerEpoch;
+    AudioBuffer **link = &retiredAudioBuffers;
+
+    while (*link != NULL)
+    {
+        AudioBuffer *audioBuffer = *link;
+
+        // Two completed callbacks guarantee that the one which applied the untrack command has finished mixing.
+        if (force || (ma_int32)(epoch - audioBuffer->retireEpoch) >= 2)
+        {
+            *link = audioBuffer->nextRetired;
+            RL_FREE(audioBuffer);
+        }
+        else
+        {
+            link = &audioBuffer->nextRetired;
+        }
+    }
+
+    AudioVoiceArray **voicesLink = &retiredAudioVoices;
+
+    while (*voicesLink != NULL)
+    {
+        AudioVoiceArray *voices = *voicesLink;
+
+        // Same as buffers, the callback that switched to the new array is done after two epochs.
+        if (force || (ma_int32)(epoch - voices->retireEpoch) >= 2)
+        {
+            *voicesLink = voices->nextRetired;
+            RL_FREE(voices);
+        }
+        else
+        {
+            voicesLink = &voices->nextRetired;
+        }
+    }
+}
+
+// Render sources are guarded by a per buffer spin lock. The audio thread only tries it and outputs silence when it is taken,
+// the game thread holds it for short engine updates (stop, reset, volume) and spins in the rare case the mixer is rendering.
+static bool TryLockAudioBufferRender(AudioBuffer *audioBuffer)
+{
+#if defined(_MSC_VER)
+    return InterlockedExchange((volatile LONG *)&audioBuffer->renderLock, 1) == 0;
+#else
+    return __sync_lock_test_and_set(&audioBuffer->renderLock, 1) == 0;
+#endif
+}
+
+static void LockAudioBufferRender(AudioBuffer *audioBuffer)
+{
+    while (!TryLockAudioBufferRender(audioBuffer))
+    {
+#if !defined(MA_EMSCRIPTEN)
+        ma_sleep(0); // The mixer runs on this thread with Web Audio, so it can't be holding the lock there.
+#endif
+    }
+}
+
+static void UnlockAudioBufferRender(AudioBuffer *audioBuffer)
+{
+#if defined(_MSC_VER)
+    InterlockedExchange((volatile LONG *)&audioBuffer->renderLock, 0);
+#else
+    __sync_lock_release(&audioBuffer->renderLock);
+#endif
+}
+
+//----------------------------------------------------------------------------------
+// Module Functions Definition - Audio Device initialization and Closing
+//----------------------------------------------------------------------------------
+// Initialize audio device
+void InitAudioDevice(void)
+{
+    // Context.
+    ma_context_config contextConfig = ma_context_config_init();
+    contextConfig.logCallback = OnLog;
+    ma_result result = ma_context_init(NULL, 0, &contextConfig, &context);
+    if (result != MA_SUCCESS)
+    {
+        TraceLog(LOG_ERROR, "Failed to initialize audio context");
+        return;
+    }
+
+    // Device. Using the default device. Format is floating point because it simplifies mixing.
+    ma_device_config config = ma_device_config_init(ma_device_type_playback);
+    config.playback.pDeviceID = NULL; // NULL for the default playback device.
+    config.playback.format = DEVICE_FORMAT;
+    config.playback.channels = DEVICE_CHANNELS;
+    config.capture.pDeviceID = NULL; // NULL for the default capture device.
+    config.capture.format = ma_format_s16;
+    config.capture.channels = 1;
+    config.sampleRate = DEVICE_SAMPLE_RATE;
+    config.dataCallback = OnSendAudioDataToDevice;
+    config.pUserData = NULL;
+
+    result = ma_device_init(&context, &config, &device);
+    if (result != MA_SUCCESS)
+    {
+        TraceLog(LOG_ERROR, "Failed to initialize audio playback device");
+        ma_context_uninit(&context);
+        return;
+    }
+
+    // Keep the device running the whole time. May want to consider doing something a bit smarter and only have the device running
+    // while there's at least one sound being played.
+    result = ma_device_start(&device);
+    if (result != MA_SUCCESS)
+    {
+        TraceLog(LOG_ERROR, "Failed to start audio playback device");
+        ma_device_uninit(&device);
+        ma_context_uninit(&context);
+        return;
+    }
+
+    TraceLog(LOG_INFO, "Audio device initialized successfully");
+    TraceLog(LOG_INFO, "Audio backend: miniaudio / %s", ma_get_backend_name(context.backend));
+    TraceLog(LOG_INFO, "Audio format: %s -> %s", ma_get_format_name(device.playback.format), ma_get_format_name(device.playback.internalFormat));
+    TraceLog(LOG_INFO, "Audio channels: %d -> %d", device.playback.channels, device.playback.internalChannels);
+    TraceLog(LOG_INFO, "Audio sample rate: %d -> %d", device.sampleRate, device.playback.internalSampleRate);
+    TraceLog(LOG_INFO, "Audio buffer size: %d", device.playback.internalBufferSizeInFrames);
+
+    isAudioInitialized = MA_TRUE;
+}
+
+// Close the audio device for all contexts
+void CloseAudioDevice(void)
+{
+    if (!isAudioInitialized)
+    {
+        TraceLog(LOG_WARNING, "Could not close audio device because it is not currently initialized");
+        return;
+    }
+
+    StopMusicRenderThread();
+    StopMusicLoaderThreads();
+
+    ma_device_uninit(&device);
+    ma_context_uninit(&context);
+    isAudioInitialized = MA_FALSE;
+
+    // The audio thread is gone, nothing references retired buffers anymore.
+    ReleaseRetiredAudioBuffers(true);
+    RL_FREE(postedAudioVoices);
+    postedAudioVoices = NULL;
+    audioVoices = NULL;
+    audioVoiceCount = 0;
+
+    TraceLog(LOG_INFO, "Audio device closed successfully");
+}
+
+// Check if device has been initialized successfully
+bool IsAudioDeviceReady(void)
+{
+    return isAudioInitialized;
+}
+
+// Set master volume (listener)
+void SetMasterVolume(float volume)
+{
+    if (volume < 0.0f)
+        volume = 0.0f;
+    else if (volume > 1.0f)
+        volume = 1.0f;
+
+    masterVolume = volume;
+}
+
+//----------------------------------------------------------------------------------
+// Module Functions Definition - Audio Buffer management
+//----------------------------------------------------------------------------------
+
+// Create a new audio buffer. Initially filled with silence
+AudioBuffer *CreateAudioBuffer(ma_format format, ma_uint32 channels, ma_uint32 sampleRate, ma_uint32 bufferSizeInFrames, AudioBufferUsage usage)
+{
+    // Good time to give memory of unloaded buffers back.
+    ReleaseRetiredAudioBuffers(false);
+
+    // The mixer gets a bigger voice array before it is asked to track one buffer too many.
+    if (isAudioInitialized && (trackedAudioBufferCount >= ((postedAudioVoices != NULL) ? postedAudioVoices->capacity : 0)))
+    {
+        if (!GrowAudioVoices())
+            return NULL;
+    }
+
+    AudioBuffer *audioBuffer = (AudioBuffer *)RL_CALLOC(sizeof(*audioBuffer) + (bufferSizeInFrames * channels * ma_get_bytes_per_sample(format)), 1);
+    if (audioBuffer == NULL)
+    {
+        TraceLog(LOG_ERROR, "CreateAudioBuffer() : Failed to allocate memory for audio buffer");
+        return NULL;
+    }
+
+    // We run audio data through a format converter.
+    ma_pcm_converter_config dspConfig;
+    memset(&dspConfig, 0, sizeof(dspConfig));
+    dspConfig.formatIn = format;
+    dspConfig.formatOut = DEVICE_FORMAT;
+    dspConfig.channelsIn = channels;
+    dspConfig.channelsOut = DEVICE_CHANNELS;
+    dspConfig.sampleRateIn = sampleRate;
+    dspConfig.sampleRateOut = device.sampleRate;
+    dspConfig.onRead = OnAudioBufferDSPRead;
+    dspConfig.pUserData = audioBuffer;
+    dspConfig.allowDynamicSampleRate = MA_TRUE; // <-- Required for pitch shifting.
+    ma_result result = ma_pcm_converter_init(&dspConfig, &audioBuffer->dsp);
+
+    if (result != MA_SUCCESS)
+    {
+        TraceLog(LOG_ERROR, "CreateAudioBuffer() : Failed to create data conversion pipeline");
+        RL_FREE(audioBuffer);
+        return NULL;
+    }
+
+    audioBuffer->volume = 1.0f;
+    audioBuffer->pitch = 1.0f;
+    audioBuffer->playing = false;
+    audioBuffer->paused = false;
+    audioBuffer->looping = false;
+    audioBuffer->usage = usage;
+    audioBuffer->bufferSizeInFrames = bufferSizeInFrames;
+    audioBuffer->periodSizeInFrames = bufferSizeInFrames / MAX_STREAM_BUFFERS;
+    audioBuffer->frameCursorPos = 0;
+    audioBuffer->writeFrame = 0;
+    audioBuffer->readFrame = 0;
+    audioBuffer->voiceIndex = -1;
+
+    TrackAudioBuffer(audioBuffer);
+
+    return audioBuffer;
+}
+
+// Delete an audio buffer
+// NOTE: Memory is released later, once the mixer is guaranteed to be done with it
+void DeleteAudioBuffer(AudioBuffer *audioBuffer)
+{
+    if (audioBuffer == NULL)
+    {
+        TraceLog(LOG_ERROR, "DeleteAudioBuffer() : No audio buffer");
+        return;
+    }
+
+    UntrackAudioBuffer(audioBuffer);
+
+    audioBuffer->retireEpoch = mixerEpoch;
+    audioBuffer->nextRetired = retiredAudioBuffers;
+    retiredAudioBuffers = audioBuffer;
+
+    ReleaseRetiredAudioBuffers(!isAudioInitialized);
+}
+
+// Check if an audio buffer is playing
+bool IsAudioBufferPlaying(AudioBuffer *audioBuffer)
+{
+    if (audioBuffer == NULL)
+    {
         TraceLog(LOG_ERROR, "IsAudioBufferPlaying() : No audio buffer");
         return false;
     }
 
-    return audioBuffer->playing && !audioBuffer->paused;
-}
+    // A non looping buffer that reached its end is stopped by the mixer, unless it was played again since.
+    return audioBuffer->playing && !audioBuffer->paused && (audioBuffer->endedPlayCount != audioBuffer->playCount);
+}
+
+// Play an audio buffer
+// NOTE: Buffer is restarted to the start.
+// Use PauseAudioBuffer() and ResumeAudioBuffer() if the playback position should be maintained.
+void PlayAudioBuffer(AudioBuffer *audioBuffer)
+{
+    if (audioBuffer == NULL)
+    {
+        TraceLog(LOG_ERROR, "PlayAudioBuffer() : No audio buffer");
+        return;
+    }
+
+    audioBuffer->playing = true;
+    audioBuffer->paused = false;
+    PushAudioCommand(AUDIO_COMMAND_PLAY, audioBuffer, 1.0f);
+}
+
+// Stop an audio buffer
+void StopAudioBuffer(AudioBuffer *audioBuffer)
+{
+    if (audioBuffer == NULL)
+    {
+        TraceLog(LOG_ERROR, "StopAudioBuffer() : No audio buffer");
+        return;
+    }
+
+    // Don't do anything if the audio buffer is already stopped.
+    if (!IsAudioBufferPlaying(audioBuffer))
+        return;
+
+    // Queued stream frames are dropped by the mixer when it applies the stop.
+    audioBuffer->playing = false;
+    audioBuffer->paused = false;
+    PushAudioCommand(AUDIO_COMMAND_STOP, audioBuffer, 0.0f);
+}
+
+// Pause an audio buffer
+void PauseAudioBuffer(AudioBuffer *audioBuffer)
+{
+    if (audioBuffer == NULL)
+    {
+        TraceLog(LOG_ERROR, "PauseAudioBuffer() : No audio buffer");
+        return;
+    }
+
+    audioBuffer->paused = true;
+    PushAudioCommand(AUDIO_COMMAND_PAUSE, audioBuffer, 0.0f);
+}
+
+// Resume an audio buffer
+void ResumeAudioBuffer(AudioBuffer *audioBuffer)
+{
+    if (audioBuffer == NULL)
+    {
+        TraceLog(LOG_ERROR, "ResumeAudioBuffer() : No audio buffer");
+        return;
+    }
+
+    audioBuffer->paused = false;
+    PushAudioCommand(AUDIO_COMMAND_RESUME, audioBuffer, 0.0f);
+}
+
+// Set volume for an audio buffer
+void SetAudioBufferVolume(AudioBuffer *audioBuffer, float volume)
+{
+    if (audioBuffer == NULL)
+    {
+        TraceLog(LOG_WARNING, "SetAudioBufferVolume() : No audio buffer");
+        return;
+    }
+
+    if (audioBuffer->volume == volume)
+        return;
+
+    audioBuffer->volume = volume;
+    PushAudioCommand(AUDIO_COMMAND_VOLUME, audioBuffer, volume);
+}
+
+// Set pitch for an audio buffer
+void SetAudioBufferPitch(AudioBuffer *audioBuffer, float pitch)
+{
+    if (audioBuffer == NULL)
+    {
+        TraceLog(LOG_WARNING, "SetAudioBufferPitch() : No audio buffer");
+        return;
+    }
+
+    if (pitch <= 0.0f)
+    {
+        TraceLog(LOG_WARNING, "SetAudioBufferPitch() : Pitch must be greater than 0");
+        return;
+    }
+
+    if (audioBuffer->pitch == pitch)
+        return;
+
+    // The converter belongs to the audio thread, so the new output sample rate is applied by the mixer.
+    audioBuffer->pitch = pitch;
+    PushAudioCommand(AUDIO_COMMAND_PITCH, audioBuffer, pitch);
+}
+
+// Hand audio buffer over to the mixer
+void TrackAudioBuffer(AudioBuffer *audioBuffer)
+{
+    trackedAudioBufferCount++;
+    PushAudioCommand(AUDIO_COMMAND_TRACK, audioBuffer, 0.0f);
+}
+
+// Take audio buffer back from the mixer
+void UntrackAudioBuffer(AudioBuffer *audioBuffer)
+{
+    trackedAudioBufferCount--;
+    PushAudioCommand(AUDIO_COMMAND_UNTRACK, audioBuffer, 0.0f);
+}
+
+//----------------------------------------------------------------------------------
+// Module Functions Definition - Music loading and stream playing (.OGG)
+//----------------------------------------------------------------------------------
+// Advance the music engine without rendering
+static void SkipMusicFrames(Music music, unsigned int frameCount)
+{
+    if (music->ctxType == MUSIC_MODULE_XM)
+        jar_xm_skip_samples(music->ctxXm, frameCount);
+    else if (music->ctxType == MUSIC_MODULE_MOD)
+        jar_mod_skip_samples(&music->ctxMod, frameCount);
+}
+
+// Save the engine state into a checkpoint of the seek index
+static void SaveMusicCheckpoint(Music music, unsigned int index)
+{
+    void *state = music->checkpoints + (size_t)index * music->checkpointSize;
+
+    if (music->ctxType == MUSIC_MODULE_XM)
+        jar_xm_save_state(music->ctxXm, state);
+    else if (music->ctxType == MUSIC_MODULE_MOD)
+        jar_mod_save_state(&music->ctxMod, state);
+}
+
+// Restore the engine state of a checkpoint, at the current engine pitch
+static void LoadMusicCheckpoint(Music music, unsigned int index)
+{
+    const void *state = music->checkpoints + (size_t)index * music->checkpointSize;
+
+    if (music->ctxType == MUSIC_MODULE_XM)
+        jar_xm_load_state(music->ctxXm, state);
+    else if (music->ctxType == MUSIC_MODULE_MOD)
+        jar_mod_load_state(&music->ctxMod, state);
+}
+
+// Restart music context from the beginning
+// NOTE: The caller must hold the render lock of the music stream
+static void ResetMusicContext(Music music)
+{
+    LoadMusicCheckpoint(music, 0);
+
+    music->samplesLeft = music->totalSamples;
+    music->samplesFraction = 0.0f;
+}
+
+// Set the pitch the music engine renders at
+static void SetMusicEnginePitch(Music music, float pitch)
+{
+    if (music->ctxType == MUSIC_MODULE_XM)
+        jar_xm_set_pitch(music->ctxXm, pitch);
+    else if (music->ctxType == MUSIC_MODULE_MOD)
+        jar_mod_set_pitch(&music->ctxMod, pitch);
+}
+
+// Hand the requested pitch to the music engine
+// NOTE: Pitch scales the channel steps and the tick length of the engine, so music is never resampled for pitch.
+// The caller must hold the render lock of the music stream
+static void ApplyMusicPitch(Music music)
+{
+    float pitch = music->pitch;
+
+    if (music->enginePitch == pitch)
+        return;
+
+    SetMusicEnginePitch(music, pitch);
+
+    music->enginePitch = pitch;
+}
+
+// Start the seek index of a music, the current engine state is the start of the music
+static bool InitMusicCheckpoints(Music music)
+{
+    if (music->ctxType == MUSIC_MODULE_XM)
+        music->checkpointSize = (unsigned int)jar_xm_get_state_size(music->ctxXm);
+    else
+        music->checkpointSize = (unsigned int)jar_mod_get_state_size(&music->ctxMod);
+
+    music->checkpointInterval = MUSIC_CHECKPOINT_SECONDS * music->sampleRate;
+    music->checkpointCount = 0;
+    music->checkpoints = (unsigned char *)RL_MALLOC(music->checkpointSize);
+
+    if (music->checkpoints == NULL)
+        return false;
+
+    SaveMusicCheckpoint(music, 0);
+    music->checkpointCount = 1;
+
+    return true;
+}
+
+// Move the music engine to a position, in music frames from the start
+// NOTE: The nearest checkpoint is restored and only the remainder is skipped. The index grows as seeks go further, so
+// any position is reached by skipping at most checkpointInterval frames once it has been seeked past.
+// Engines skip without mixing, at pitch 1 so that frames are music frames. The caller must hold the render lock
+static void SeekMusicContext(Music music, unsigned int position)
+{
+    unsigned int index = position / music->checkpointInterval;
+
+    SetMusicEnginePitch(music, 1.0f);
+
+    if (index >= music->checkpointCount)
+    {
+        unsigned char *checkpoints = (unsigned char *)RL_REALLOC(music->checkpoints, (size_t)(index + 1) * music->checkpointSize);
+
+        // Without room for the new checkpoints, skip all the way from the last one
+        if (checkpoints == NULL)
+            index = music->checkpointCount - 1;
+        else
+            music->checkpoints = checkpoints;
+    }
+
+    if (index < music->checkpointCount)
+    {
+        LoadMusicCheckpoint(music, index);
+    }
+    else
+    {
+        LoadMusicCheckpoint(music, music->checkpointCount - 1);
+
+        while (music->checkpointCount <= index)
+        {
+            SkipMusicFrames(music, music->checkpointInterval);
+            SaveMusicCheckpoint(music, music->checkpointCount);
+            music->checkpointCount++;
+        }
+    }
+
+    SkipMusicFrames(music, position - index * music->checkpointInterval);
+
+    SetMusicEnginePitch(music, music->enginePitch);
+
+    music->samplesLeft = music->totalSamples - position;
+    music->samplesFraction = 0.0f;
+}
+
+// Get the number of output frames until the end of the music at the current pitch
+static unsigned int GetMusicFramesLeft(Music music)
+{
+    if (music->enginePitch == 1.0f)
+        return music->samplesLeft;
+
+    return (unsigned int)ceil(((double)music->samplesLeft - music->samplesFraction) / music->enginePitch);
+}
+
+// Move the music position after frameCount output frames were rendered
+static void AdvanceMusicPosition(Music music, unsigned int frameCount)
+{
+    float advance = (float)frameCount * music->enginePitch + music->samplesFraction;
+    unsigned int samples = (unsigned int)advance;
+
+    music->samplesFraction = advance - (float)samples;
+    music->samplesLeft = (samples < music->samplesLeft) ? (music->samplesLeft - samples) : 0;
+}
+
+// Render stereo float frames from the music engine
+// NOTE: XM renders floats natively, MOD is rendered in chunks through the music scratch buffer and converted
+static void GenerateMusicFrames(Music music, float *pcm, unsigned int frameCount)
+{
+    if (music->ctxType == MUSIC_MODULE_XM)
+    {
+        jar_xm_generate_samples(music->ctxXm, pcm, frameCount);
+    }
+    else if (music->ctxType == MUSIC_MODULE_MOD)
+    {
+        while (frameCount > 0)
+        {
+            unsigned int framesToGenerate = (frameCount < MUSIC_SCRATCH_FRAMES) ? frameCount : MUSIC_SCRATCH_FRAMES;
+
+            // NOTE: 3rd parameter (nbsample) specify the number of stereo 16bits samples you want
+            jar_mod_fillbuffer(&music->ctxMod, music->modScratch, framesToGenerate, 0);
+
+            for (unsigned int i = 0; i < framesToGenerate * 2; i++)
+                pcm[i] = (float)music->modScratch[i] * (1.0f / 32768.0f);
+
+            pcm += framesToGenerate * 2;
+            frameCount -= framesToGenerate;
+        }
+    }
+}
+
+// Render music frames on the audio thread (MUSIC_RENDER_CALLBACK)
+// NOTE: Loops are handled in place, the end of the music is reported to UpdateMusicStream() through renderFinished
+static ma_uint32 OnMusicRender(void *pUserData, void *pFramesOut, ma_uint32 frameCount)
+{
+    Music music = (Music)pUserData;
+    float *pcm = (float *)pFramesOut;
+    ma_uint32 framesRendered = 0;
+
+    ApplyMusicPitch(music);
+
+    while ((framesRendered < frameCount) && !music->renderFinished)
+    {
+        ma_uint32 framesToRender = frameCount - framesRendered;
+        ma_uint32 framesLeft = GetMusicFramesLeft(music);
+        if (framesToRender > framesLeft)
+            framesToRender = framesLeft;
+
+        if (framesToRender > 0)
+        {
+            // NOTE: Both engines render interleaved stereo float frames
+            GenerateMusicFrames(music, pcm + (framesRendered * 2), framesToRender);
+
+            framesRendered += framesToRender;
+            AdvanceMusicPosition(music, framesToRender);
+        }
+
+        if (music->samplesLeft == 0)
+        {
+            if ((music->loopCount != 0) && (music->totalSamples > 0))
+            {
+                if (music->loopCount > 0)
+                    music->loopCount--;
+
+                ResetMusicContext(music);
+            }
+            else
+            {
+                music->renderFinished = true;
+            }
+        }
+    }
+
+    return framesRendered;
+}
+
+//----------------------------------------------------------------------------------
+// Render-ahead thread (MUSIC_RENDER_THREAD)
+//----------------------------------------------------------------------------------
+// NOTE: A single worker keeps the stream ring of every registered music full, the mixer only copies from it.
+// The registry lock is held for a whole pass, so a music is never touched by the worker once it has been removed.
+#define MUSIC_RENDER_THREAD_INTERVAL 2 // Milliseconds between two passes of the worker
+
+static ma_thread renderThread;
+static ma_mutex renderThreadLock;
+static volatile bool renderThreadRunning = false;
+static Music *renderThreadMusics = NULL;
+static ma_uint32 renderThreadMusicCount = 0;
+static ma_uint32 renderThreadMusicCapacity = 0;
+
+// Fill the stream ring of a music as far as it goes (render thread only)
+static void RenderMusicAhead(Music music)
+{
+    AudioBuffer *audioBuffer = (AudioBuffer *)music->stream.audioBuffer;
+
+    if (!audioBuffer->playing || audioBuffer->paused)
+        return;
+
+    // The game thread is stopping or resetting this music, it will be picked up again next pass.
+    if (!TryLockAudioBufferRender(audioBuffer))
+        return;
+
+    ma_uint32 frameSize = music->stream.channels * (music->stream.sampleSize / 8);
+    ma_uint32 framesFree = audioBuffer->bufferSizeInFrames - GetAudioBufferFramesQueued(audioBuffer);
+
+    while ((framesFree >= audioBuffer->periodSizeInFrames) && !music->renderFinished)
+    {
+        ma_uint32 write = audioBuffer->writeFrame;
+        ma_uint32 firstFrame = write % audioBuffer->bufferSizeInFrames;
+        ma_uint32 framesToRender = audioBuffer->bufferSizeInFrames - firstFrame;
+        if (framesToRender > framesFree)
+            framesToRender = framesFree;
+
+        // Render straight into the ring, the mixer won't read past the write cursor.
+        ma_uint32 framesRendered = OnMusicRender(music, audioBuffer->buffer + (firstFrame * frameSize), framesToRender);
+
+        ma_memory_barrier(); // Publish the frames before moving the write cursor.
+        audioBuffer->writeFrame = (write + framesRendered) % (audioBuffer->bufferSizeInFrames * 2);
+        framesFree -= framesRendered;
+    }
+
+    UnlockAudioBufferRender(audioBuffer);
+}
+
+static ma_thread_result MA_THREADCALL MusicRenderThreadProc(void *pData)
+{
+    (void)pData;
+
+#if defined(RAUDIO_COUNT_ALLOCATIONS)
+    isAudioThread = true;
+#endif
+
+    while (renderThreadRunning)
+    {
+        ma_mutex_lock(&renderThreadLock);
+
+        for (ma_uint32 i = 0; i < renderThreadMusicCount; i++)
+            RenderMusicAhead(renderThreadMusics[i]);
+
+        ma_mutex_unlock(&renderThreadLock);
+
+        ma_sleep(MUSIC_RENDER_THREAD_INTERVAL);
+    }
+
+    return (ma_thread_result)0;
+}
+
+// Start the render-ahead thread on first use
+static bool StartMusicRenderThread(void)
+{
+    if (renderThreadRunning)
+        return true;
+
+    if (!isAudioInitialized)
+        return false;
+
+    if (ma_mutex_init(&context, &renderThreadLock) != MA_SUCCESS)
+    {
+        TraceLog(LOG_ERROR, "Failed to create music render thread lock");
+        return false;
+    }
+
+    renderThreadMusicCount = 0;
+    renderThreadRunning = true;
+
+    if (ma_thread_create(&context, &renderThread, MusicRenderThreadProc, NULL) != MA_SUCCESS)
+    {
+        TraceLog(LOG_ERROR, "Failed to create music render thread");
+        renderThreadRunning = false;
+        ma_mutex_uninit(&renderThreadLock);
+        return false;
+    }
+
+    return true;
+}
+
+static void StopMusicRenderThread(void)
+{
+    if (!renderThreadRunning)
+        return;
+
+    renderThreadRunning = false;
+    ma_thread_wait(&renderThread);
+    ma_mutex_uninit(&renderThreadLock);
+    RL_FREE(renderThreadMusics);
+    renderThreadMusics = NULL;
+    renderThreadMusicCount = 0;
+    renderThreadMusicCapacity = 0;
+}
+
+// Make room for one more music in the render-ahead thread
+static bool ReserveMusicRenderThread(void)
+{
+    bool reserved = true;
+
+    ma_mutex_lock(&renderThreadLock);
+
+    // The worker only reads the list under the lock, so it can move while growing.
+    if (renderThreadMusicCount == renderThreadMusicCapacity)
+    {
+        ma_uint32 capacity = (renderThreadMusicCapacity == 0) ? AUDIO_VOICES_INITIAL_CAPACITY : (renderThreadMusicCapacity * 2);
+        Music *musics = (Music *)RL_REALLOC(renderThreadMusics, capacity * sizeof(Music));
+
+        if (musics != NULL)
+        {
+            renderThreadMusics = musics;
+            renderThreadMusicCapacity = capacity;
+        }
+        else
+        {
+            TraceLog(LOG_ERROR, "ReserveMusicRenderThread() : Failed to allocate memory for %i musics", capacity);
+            reserved = false;
+        }
+    }
+
+    ma_mutex_unlock(&renderThreadLock);
+
+    return reserved;
+}
+
+// Add or remove a music from the render-ahead thread
+static void RegisterMusicRenderThread(Music music, bool registered)
+{
+    if (!renderThreadRunning)
+        return;
+
+    ma_mutex_lock(&renderThreadLock);
+
+    if (registered)
+    {
+        // Room was made by ReserveMusicRenderThread().
+        renderThreadMusics[renderThreadMusicCount++] = music;
+    }
+    else
+    {
+        for (ma_uint32 i = 0; i < renderThreadMusicCount; i++)
+        {
+            if (renderThreadMusics[i] == music)
+            {
+                renderThreadMusics[i] = renderThreadMusics[--renderThreadMusicCount];
+                break;
+            }
+        }
+    }
+
+    ma_mutex_unlock(&renderThreadLock);
+}
+
+// Modules are rendered at the device rate, so the mixer can pass them through without resampling
+static unsigned int GetMusicSampleRate(void)
+{
+    return (isAudioInitialized && (device.sampleRate > 0)) ? device.sampleRate : MUSIC_SAMPLE_RATE;
+}
+
+// Load music stream from file
+Music LoadMusicStream(const char *fileName)
+{
+    return LoadMusicStreamEx(fileName, 0, 0);
+}
+
+//----------------------------------------------------------------------------------
+// Module Functions Definition - Music info cache
+//----------------------------------------------------------------------------------
+// NOTE: Module length is only known after a pass over the whole song, which is slow for MOD. Results are kept by content
+// hash (and render rate), in memory and optionally in a cache file, so a module is only measured once.
+#define MUSIC_INFO_CACHE_MAGIC "RMIC"
+#define MUSIC_INFO_CACHE_VERSION 3
+
+typedef struct MusicInfo
+{
+    ma_uint64 hash;         // FNV-1a hash of the module file
+    ma_uint32 fileSize;     // Module file size in bytes
+    ma_uint32 sampleRate;   // Render rate, the length in frames depends on it
+    ma_uint32 totalSamples; // Song length in frames
+} MusicInfo;
+
+static MusicInfo *musicInfoCache = NULL;
+static ma_uint32 musicInfoCount = 0;
+static ma_uint32 musicInfoCapacity = 0;
+static volatile ma_int32 musicInfoLock = 0; // Offline renders load modules from worker threads
+static char musicInfoCacheFile[512] = { 0 };
+
+static void LockMusicInfoCache(void)
+{
+#if defined(_MSC_VER)
+    while (InterlockedExchange((volatile LONG *)&musicInfoLock, 1) != 0)
+#else
+    while (__sync_lock_test_and_set(&musicInfoLock, 1) != 0)
+#endif
+    {
+#if !defined(MA_EMSCRIPTEN)
+        ma_sleep(0);
+#endif
+    }
+}
+
+static void UnlockMusicInfoCache(void)
+{
+#if defined(_MSC_VER)
+    InterlockedExchange((volatile LONG *)&musicInfoLock, 0);
+#else
+    __sync_lock_release(&musicInfoLock);
+#endif
+}
+
+// Open a regular file, not an application asset
+// NOTE: fopen() is routed to the asset manager on Android, the parentheses skip that macro
+static FILE *OpenLocalFile(const char *fileName, const char *mode)
+{
+    return (fopen)(fileName, mode);
+}
+
+#if !defined(RAUDIO_MMAP)
+// Load the whole file into memory, free it with RL_FREE()
+static unsigned char *LoadFileData(const char *fileName, unsigned int *bytesRead)
+{
+    unsigned char *data = NULL;
+    *bytesRead = 0;
+
+    FILE *file = fopen(fileName, "rb");
+
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (size > 0)
+    {
+        data = (unsigned char *)RL_MALLOC(size);
+
+        if ((data != NULL) && (fread(data, 1, size, file) == (size_t)size))
+        {
+            *bytesRead = (unsigned int)size;
+        }
+        else
+        {
+            RL_FREE(data);
+            data = NULL;
+        }
+    }
+
+    fclose(file);
+
+    return data;
+}
+
+#endif
+
+// Map the whole file read-only, free it with UnmapFileData()
+// NOTE: The pages are shared with the page cache, reading them doesn't copy the file
+static unsigned char *MapFileData(const char *fileName, unsigned int *bytesRead)
+{
+#if defined(RAUDIO_MMAP)
+    unsigned char *data = NULL;
+    struct stat st;
+    *bytesRead = 0;
+
+    int fd = open(fileName, O_RDONLY);
+
+    if (fd < 0)
+        return NULL;
+
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0) && ((ma_uint64)st.st_size <= UINT_MAX))
+    {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (map != MAP_FAILED)
+        {
+            data = (unsigned char *)map;
+            *bytesRead = (unsigned int)st.st_size;
+        }
+    }
+
+    close(fd); // The mapping keeps the file open
+
+    return data;
+#else
+    return LoadFileData(fileName, bytesRead);
+#endif
+}
+
+// Free the file data of MapFileData()
+static void UnmapFileData(unsigned char *data, unsigned int bytesRead)
+{
+#if defined(RAUDIO_MMAP)
+    if (data != NULL)
+        munmap(data, bytesRead);
+#else
+    RL_FREE(data);
+#endif
+}
+
+// Set the cache key of a module file
+static void InitMusicInfo(MusicInfo *info, const unsigned char *data, unsigned int dataSize, unsigned int sampleRate)
+{
+    ma_uint64 hash = 14695981039346656037ULL;
+
+    memset(info, 0, sizeof(MusicInfo)); // Records are written whole, padding included
+
+    for (unsigned int i = 0; i < dataSize; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+
+    info->hash = hash;
+    info->fileSize = dataSize;
+    info->sampleRate = sampleRate;
+}
+
+static MusicInfo *FindMusicInfo(const MusicInfo *key)
+{
+    for (ma_uint32 i = 0; i < musicInfoCount; i++)
+    {
+        MusicInfo *info = &musicInfoCache[i];
+
+        if ((info->hash == key->hash) && (info->fileSize == key->fileSize) && (info->sampleRate == key->sampleRate))
+            return info;
+    }
+
+    return NULL;
+}
+
+// Add a measured module to the memory table
+// NOTE: The caller must hold the cache lock
+static bool InsertMusicInfo(const MusicInfo *info)
+{
+    if (FindMusicInfo(info) != NULL)
+        return false;
+
+    if (musicInfoCount == musicInfoCapacity)
+    {
+        ma_uint32 capacity = (musicInfoCapacity == 0) ? 16 : (musicInfoCapacity * 2);
+        MusicInfo *cache = (MusicInfo *)RL_REALLOC(musicInfoCache, capacity * sizeof(MusicInfo));
+
+        if (cache == NULL)
+            return false;
+
+        musicInfoCache = cache;
+        musicInfoCapacity = capacity;
+    }
+
+    musicInfoCache[musicInfoCount++] = *info;
+
+    return true;
+}
+
+// Fill the cached info of a module, returns false if it was never measured
+static bool GetCachedMusicInfo(MusicInfo *info)
+{
+    LockMusicInfoCache();
+
+    MusicInfo *cached = FindMusicInfo(info);
+
+    if (cached != NULL)
+        *info = *cached;
+
+    UnlockMusicInfoCache();
+
+    return (cached != NULL);
+}
+
+// Remember a measured module, appending it to the cache file if there is one
+static void CacheMusicInfo(const MusicInfo *info)
+{
+    LockMusicInfoCache();
+
+    if (InsertMusicInfo(info) && (musicInfoCacheFile[0] != '\0'))
+    {
+        FILE *file = OpenLocalFile(musicInfoCacheFile, "ab");
+
+        if (file != NULL)
+        {
+            fwrite(info, sizeof(MusicInfo), 1, file);
+            fclose(file);
+        }
+    }
+
+    UnlockMusicInfoCache();
+}
+
+// Keep module lengths in a cache file
+// NOTE: Known entries are loaded now and new ones are appended as modules are measured. The file is a plain record
+// dump, it is only valid on the platform that wrote it and is started over if it doesn't match.
+void SetMusicInfoCacheFile(const char *fileName)
+{
+    if ((fileName == NULL) || (strlen(fileName) >= sizeof(musicInfoCacheFile)))
+    {
+        TraceLog(LOG_WARNING, "SetMusicInfoCacheFile() : Invalid cache file name");
+        return;
+    }
+
+    LockMusicInfoCache();
+
+    strcpy(musicInfoCacheFile, fileName);
+
+    char magic[4] = { 0 };
+    ma_uint32 header[2] = { 0 };
+    ma_uint32 entries = 0;
+    FILE *file = OpenLocalFile(fileName, "rb");
+
+    if (file != NULL)
+    {
+        bool valid = (fread(magic, 1, 4, file) == 4) && (memcmp(magic, MUSIC_INFO_CACHE_MAGIC, 4) == 0) &&
+                     (fread(header, sizeof(ma_uint32), 2, file) == 2) &&
+                     (header[0] == MUSIC_INFO_CACHE_VERSION) && (header[1] == sizeof(MusicInfo));
+
+        MusicInfo info;
+
+        while (valid && (fread(&info, sizeof(MusicInfo), 1, file) == 1))
+        {
+            InsertMusicInfo(&info);
+            entries++;
+        }
+
+        fclose(file);
+
+        if (!valid)
+            file = NULL;
+    }
+
+    // Missing or foreign cache file, start a new one
+    if (file == NULL)
+    {
+        file = OpenLocalFile(fileName, "wb");
+
+        if (file != NULL)
+        {
+            header[0] = MUSIC_INFO_CACHE_VERSION;
+            header[1] = sizeof(MusicInfo);
+            fwrite(MUSIC_INFO_CACHE_MAGIC, 1, 4, file);
+            fwrite(header, sizeof(ma_uint32), 2, file);
+
+            // Modules measured before the cache file was set
+            fwrite(musicInfoCache, sizeof(MusicInfo), musicInfoCount, file);
+            fclose(file);
+        }
+        else
+        {
+            TraceLog(LOG_WARNING, "SetMusicInfoCacheFile() : Cache file could not be created [%s]", fileName);
+            musicInfoCacheFile[0] = '\0';
+        }
+    }
+
+    UnlockMusicInfoCache();
+
+    TraceLog(LOG_INFO, "Music info cache [%s]: %u entries loaded", fileName, entries);
+}
+
+// Set up the playback fields of a music, before its engine is loaded
+static void InitMusicData(Music music, unsigned int sampleRate)
+{
+    music->sampleRate = sampleRate;
+    music->renderMode = MUSIC_RENDER_UPDATE;
+    music->renderFinished = false;
+    music->pitch = 1.0f;
+    music->enginePitch = 1.0f;
+    music->samplesFraction = 0.0f;
+    music->moduleHash = 0;
+    music->pcm = NULL;
+    music->checkpoints = NULL;
+}
+
+// Load the XM engine from the module data, data is only read while loading
+static bool LoadMusicModuleXM(Music music, const char *name, const unsigned char *data, unsigned int dataSize)
+{
+    bool musicLoaded = false;
+    MusicInfo info;
+    bool cached = false;
+
+    if (!jar_xm_create_context_safe(&music->ctxXm, (const char *)data, dataSize, music->sampleRate)) // XM context created successfully
+    {
+
+        jar_xm_set_max_loop_count(music->ctxXm, 0); // Set infinite number of loops
+
+        InitMusicInfo(&info, data, dataSize, music->sampleRate);
+        cached = GetCachedMusicInfo(&info);
+
+        music->ctxType = MUSIC_MODULE_XM;
+        music->moduleHash = info.hash;
+        musicLoaded = InitMusicCheckpoints(music);
+
+        if (musicLoaded && !cached)
+        {
+            info.totalSamples = (unsigned int)jar_xm_get_remaining_samples(music->ctxXm);
+            CacheMusicInfo(&info);
+            LoadMusicCheckpoint(music, 0); // Back to the start, the length pass leaves the song at its end
+        }
+
+        music->totalSamples = info.totalSamples;
+        music->samplesLeft = music->totalSamples;
+        music->loopCount = -1; // Infinite loop by default
+        TraceLog(LOG_INFO, "[%s] XM number of samples: %i%s", name, music->totalSamples, cached ? " (cached)" : "");
+        TraceLog(LOG_INFO, "[%s] XM track length: %11.6f sec", name, (float)music->totalSamples / (float)music->sampleRate);
+
+        if (!musicLoaded)
+            jar_xm_free_context(music->ctxXm);
+    }
+
+    return musicLoaded;
+}
+
+// Finish loading the MOD engine, once jar_mod has loaded the module
+static bool LoadMusicModuleMOD(Music music, const char *name)
+{
+    bool musicLoaded = false;
+    MusicInfo info;
+    bool cached = false;
+
+    // NOTE: jar_mod keeps the module file in memory, mapped where jar_mod_load_file() can map it
+    InitMusicInfo(&info, music->ctxMod.modfile, (unsigned int)music->ctxMod.modfilesize, music->sampleRate);
+    cached = GetCachedMusicInfo(&info);
+
+    if (!cached)
+    {
+        info.totalSamples = (unsigned int)jar_mod_max_samples(&music->ctxMod);
+        CacheMusicInfo(&info);
+    }
+
+    music->totalSamples = info.totalSamples;
+    music->samplesLeft = music->totalSamples;
+    music->ctxType = MUSIC_MODULE_MOD;
+    music->moduleHash = info.hash;
+    music->loopCount = -1; // Infinite loop by default
+    musicLoaded = InitMusicCheckpoints(music);
+
+    TraceLog(LOG_INFO, "[%s] MOD number of samples: %i%s", name, music->samplesLeft, cached ? " (cached)" : "");
+    TraceLog(LOG_INFO, "[%s] MOD track length: %11.6f sec", name, (float)music->totalSamples / (float)music->sampleRate);
+
+    return musicLoaded;
+}
+
+// Load the music engine of a module file, the music stream is left to the caller
+// NOTE: The engine renders stereo frames at sampleRate, loops forever by default
+static bool LoadMusicModule(Music music, const char *fileName, unsigned int sampleRate)
+{
+    bool musicLoaded = false;
+
+    InitMusicData(music, sampleRate);
+
+    if (IsFileExtension(fileName, ".xm"))
+    {
+        unsigned int dataSize = 0;
+        unsigned char *data = MapFileData(fileName, &dataSize); // The XM context copies what it plays
+
+        if (data != NULL)
+            musicLoaded = LoadMusicModuleXM(music, fileName, data, dataSize);
+
+        UnmapFileData(data, dataSize);
+    }
+    else if (IsFileExtension(fileName, ".mod"))
+    {
+        jar_mod_init(&music->ctxMod);
+        jar_mod_setcfg(&music->ctxMod, sampleRate, 16, 1, 1, 1); // Keep the jar_mod_init() defaults, only the rate changes
+
+        if (jar_mod_load_file(&music->ctxMod, fileName))
+            musicLoaded = LoadMusicModuleMOD(music, fileName);
+
+        if (!musicLoaded)
+            jar_mod_unload(&music->ctxMod);
+    }
+
+    if (!musicLoaded)
+        TraceLog(LOG_WARNING, " Music file could not be opened [%s]", fileName);
+
+    return musicLoaded;
+}
+
+// Load the music engine of a module in memory, XM and MOD are told apart by the XM header
+// NOTE: XM is parsed straight from data. jar_mod plays samples from the module data, so MOD data is copied
+static bool LoadMusicModuleFromMemory(Music music, const unsigned char *data, unsigned int dataSize, unsigned int sampleRate)
+{
+    bool musicLoaded = false;
+
+    InitMusicData(music, sampleRate);
+
+    if ((dataSize >= 17) && (memcmp(data, "Extended Module: ", 17) == 0))
+    {
+        musicLoaded = LoadMusicModuleXM(music, "memory", data, dataSize);
+    }
+    else
+    {
+        jar_mod_init(&music->ctxMod);
+        jar_mod_setcfg(&music->ctxMod, sampleRate, 16, 1, 1, 1); // Keep the jar_mod_init() defaults, only the rate changes
+
+        if (jar_mod_load_memory(&music->ctxMod, data, dataSize))
+            musicLoaded = LoadMusicModuleMOD(music, "memory");
+
+        if (!musicLoaded)
+            jar_mod_unload(&music->ctxMod);
+    }
+
+    if (!musicLoaded)
+        TraceLog(LOG_WARNING, "LoadMusicStreamFromMemory() : Music data is not a valid XM or MOD module");
+
+    return musicLoaded;
+}
+
+// Load a second music engine over the module of a loaded music, the module data is shared
+// NOTE: Only the playback state is allocated, the length is the source one
+static bool LoadMusicModuleInstance(Music music, Music source)
+{
+    bool musicLoaded = false;
+
+    InitMusicData(music, source->sampleRate);
+
+    if (source->ctxType == MUSIC_MODULE_XM)
+    {
+        if (!jar_xm_create_context_shared(&music->ctxXm, source->ctxXm, music->sampleRate))
+        {
+            jar_xm_set_max_loop_count(music->ctxXm, 0); // Set infinite number of loops
+
+            music->ctxType = MUSIC_MODULE_XM;
+            musicLoaded = InitMusicCheckpoints(music);
+
+            if (!musicLoaded)
+                jar_xm_free_context(music->ctxXm);
+        }
+    }
+    else if (source->ctxType == MUSIC_MODULE_MOD)
+    {
+        jar_mod_init(&music->ctxMod);
+        jar_mod_setcfg(&music->ctxMod, music->sampleRate, 16, 1, 1, 1); // Keep the jar_mod_init() defaults, only the rate changes
+
+        if (jar_mod_load_shared(&music->ctxMod, &source->ctxMod))
+        {
+            music->ctxType = MUSIC_MODULE_MOD;
+            musicLoaded = InitMusicCheckpoints(music);
+        }
+
+        if (!musicLoaded)
+            jar_mod_unload(&music->ctxMod);
+    }
+
+    music->totalSamples = source->totalSamples;
+    music->samplesLeft = music->totalSamples;
+    music->moduleHash = source->moduleHash;
+    music->loopCount = -1; // Infinite loop by default
+
+    if (!musicLoaded)
+        TraceLog(LOG_WARNING, "LoadMusicStreamInstance() : Music instance could not be created");
+
+    return musicLoaded;
+}
+
+// Free the music engine loaded by LoadMusicModule()
+static void UnloadMusicModule(Music music)
+{
+    if (music->ctxType == MUSIC_MODULE_XM)
+    {
+        jar_xm_free_context(music->ctxXm);
+    }
+    else if (music->ctxType == MUSIC_MODULE_MOD)
+    {
+        jar_mod_unload(&music->ctxMod);
+    }
+
+    RL_FREE(music->checkpoints);
+}
+
+// Load music stream from file with its own stream geometry
+// NOTE: bufferSizeInFrames is the refill period and buffers the number of periods in the ring, 0 uses the defaults
+Music LoadMusicStreamEx(const char *fileName, unsigned int bufferSizeInFrames, unsigned int buffers)
+{
+    Music music = (MusicData *)RL_MALLOC(sizeof(MusicData));
+
+    if (!LoadMusicModule(music, fileName, GetMusicSampleRate()))
+    {
+        RL_FREE(music);
+        return NULL;
+    }
+
+    return OpenMusicStream(music, bufferSizeInFrames, buffers);
+}
+
+// Load music stream from a module in memory (XM or MOD), data can be freed once loaded
+Music LoadMusicStreamFromMemory(const unsigned char *data, unsigned int dataSize, unsigned int bufferSizeInFrames, unsigned int buffers)
+{
+    if ((data == NULL) || (dataSize == 0))
+        return NULL;
+
+    Music music = (MusicData *)RL_MALLOC(sizeof(MusicData));
+
+    if (!LoadMusicModuleFromMemory(music, data, dataSize, GetMusicSampleRate()))
+    {
+        RL_FREE(music);
+        return NULL;
+    }
+
+    return OpenMusicStream(music, bufferSizeInFrames, buffers);
+}
+
+// Load another music stream playing the module of a loaded music, with its own stream geometry
+// NOTE: Patterns and samples are shared with the source, which can be unloaded first
+Music LoadMusicStreamInstance(Music source, unsigned int bufferSizeInFrames, unsigned int buffers)
+{
+    if (source == NULL)
+        return NULL;
+
+    Music music = (MusicData *)RL_MALLOC(sizeof(MusicData));
+
+    if (!LoadMusicModuleInstance(music, source))
+    {
+        RL_FREE(music);
+        return NULL;
+    }
+
+    return OpenMusicStream(music, bufferSizeInFrames, buffers);
+}
+
+// Give a loaded music engine its audio stream (game thread only)
+// NOTE: The music is freed if the stream can't be created
+static Music OpenMusicStream(Music music, unsigned int bufferSizeInFrames, unsigned int buffers)
+{
+    // NOTE: Only stereo is supported for XM and MOD, frames are streamed as floats like the device mixes them
+    music->stream = InitAudioStreamEx(music->sampleRate, 32, 2, bufferSizeInFrames, buffers);
+
+    AudioBuffer *audioBuffer = (AudioBuffer *)music->stream.audioBuffer;
+
+    // NOTE: Stream failures are only logged by InitAudioStream(), so this also catches them
+    if (audioBuffer != NULL)
+        music->pcm = (float *)RL_MALLOC(audioBuffer->periodSizeInFrames * music->stream.channels * music->stream.sampleSize / 8);
+
+    if (music->pcm == NULL)
+    {
+        TraceLog(LOG_ERROR, "LoadMusicStream() : Failed to allocate music buffers");
+
+        if (audioBuffer != NULL)
+            CloseAudioStream(music->stream);
+
+        UnloadMusicModule(music);
+        RL_FREE(music);
+        music = NULL;
+    }
+
+    return music;
+}
+
+// Unload music stream
+void UnloadMusicStream(Music music)
+{
+    if (music == NULL)
+        return;
+
+    // Detach the engine from the mixer before it goes away, the audio buffer itself is released later.
+    SetMusicRenderMode(music, MUSIC_RENDER_UPDATE);
+    CloseAudioStream(music->stream);
+    UnloadMusicModule(music);
+
+    RL_FREE(music->pcm);
+    RL_FREE(music);
+}
+
+void UpdateVolume(Music music, float volume, float amplification)
+{
+
+    if (music != NULL)
+    {
+        if (music->ctxType == MUSIC_MODULE_XM)
+        {
+            AudioBuffer *audioBuffer = (AudioBuffer *)music->stream.audioBuffer;
+
+            if (audioBuffer != NULL)
+                LockAudioBufferRender(audioBuffer);
+
+            music->ctxXm->global_volume = volume;
+            music->ctxXm->amplification = amplification; /* XXX: some bad modules may still clip. Find out something better. */
+
+            if (audioBuffer != NULL)
+                UnlockAudioBufferRender(audioBuffer);
+        }
+    }
+}
+
+// Start music playing (open stream)
+void PlayMusicStream(Music music) //, float volume, float amplification
+{
+    if (music != NULL)
+    {
+        AudioBuffer *audioBuffer = (AudioBuffer *)music->stream.audioBuffer;
+
+        if (audioBuffer == NULL)
+        {
+            TraceLog(LOG_ERROR, "PlayMusicStream() : No audio buffer");
+            return;
+        }
+
+        // For music streams, we need to make sure we maintain the frame cursor position. This is hack for this section of code in UpdateMusicStream()
+        //     // NOTE: In case window is minimized, music stream is stopped,
+        //     // just make sure to play again on window restore
+        //     if (IsMusicPlaying(music)) PlayMusicStream(music);
+        // The mixer is asked to play without rewinding, and only when the state actually changes.
+        if (audioBuffer->playing && !audioBuffer->paused)
+            return;
+
+        audioBuffer->playing = true;
+        audioBuffer->paused = false;
+        PushAudioCommand(AUDIO_COMMAND_PLAY, audioBuffer, 0.0f);
+    }
+}
+
+// Pause music playing
+void PauseMusicStream(Music music)
+{
+    if (music != NULL)
+        PauseAudioStream(music->stream);
+}
+
+// Resume music playing
+void ResumeMusicStream(Music music)
+{
+    if (music != NULL)
+        ResumeAudioStream(music->stream);
+}
+
+
+
+// Stop music playing (close stream)
+// TODO: To clear a buffer, make sure they have been already processed!
+void StopMusicStream(Music music)
+{
+    if (music == NULL)
+        return;
+
+    AudioBuffer *audioBuffer = (AudioBuffer *)music->stream.audioBuffer;
+
+    // Hold the engine while stopping, so the render thread can't queue frames past the flush point.
+    if (audioBuffer != NULL)
+        LockAudioBufferRender(audioBuffer);
+
+    StopAudioStream(music->stream);
+
+    // Restart music context
+    ResetMusicContext(music);
+    music->renderFinished = false;
+
+    if (audioBuffer != NULL)
+        UnlockAudioBufferRender(audioBuffer);
+}
+
+// Seek music to a position (in seconds)
+// NOTE: Frames already queued are dropped, so the new position is heard right away
+void SeekMusicStream(Music music, float position)
+{
+    if (music == NULL)
+        return;
+
+    AudioBuffer *audioBuffer = (AudioBuffer *)music->stream.audioBuffer;
+    unsigned int positionInFrames = 0;
+
+    if (position > 0.0f)
+        positionInFrames = (unsigned int)(position * music->stream.sampleRate);
+
+    if (positionInFrames >= music->totalSamples)
+    {
+        TraceLog(LOG_WARNING, "SeekMusicStream() : Position is past the end of the music");
+        return;
+    }
+
+    if (audioBuffer != NULL)
+        LockAudioBufferRender(audioBuffer);
+
+    SeekMusicContext(music, positionInFrames);
+    music->renderFinished = false;
+
+    if (audioBuffer != NULL)
+    {
+        PushAudioCommand(AUDIO_COMMAND_FLUSH, audioBuffer, 0.0f);
+        UnlockAudioBufferRender(audioBuffer);
+    }
+}
+
+// Get the size of a music playback state
+unsigned int GetMusicStateSize(Music music)
+{
+    if (music == NULL)
+        return 0;
+
+    return sizeof(MusicStateHeader) + music->checkpointSize;
+}
+
+// Save the playback state of a music (position, channels, envelopes, effect memory)
+// NOTE: state must hold GetMusicStateSize() bytes. It can be restored in this music, or in the same module loaded later
+void SaveMusicState(Music music, void *state)
+{
+    if ((music == NULL) || (state == NULL))
+        return;
+
+    MusicStateHeader *header = (MusicStateHeader *)state;
+    AudioBuffer *audioBuffer = (AudioBuffer *)music->stream.audioBuffer;
+
+    if (audioBuffer != NULL)
+        LockAudioBufferRender(audioBuffer);
+
+    header->magic = MUSIC_STATE_MAGIC;
+    header->ctxType = music->ctxType;
+    header->engineSize = music->checkpointSize;
+    header->sampleRate = music->sampleRate;
+    header->totalSamples = music->totalSamples;
+    header->samplesLeft = music->samplesLeft;
+    header->samplesFraction = music->samplesFraction;
+    header->reserved = 0;
+    header->moduleHash = music->moduleHash;
+
+    // NOTE: Frames rendered ahead and not heard yet are saved as played
+    if (music->ctxType == MUSIC_MODULE_XM)
+        jar_xm_save_state(music->ctxXm, header + 1);
+    else if (music->ctxType == MUSIC_MODULE_MOD)
+        jar_mod_save_state(&music->ctxMod, header + 1);
+
+    if (audioBuffer != NULL)
+        UnlockAudioBufferRender(audioBuffer);
+}
+
+// Restore a playback state saved by SaveMusicState()
+// NOTE: Frames already queued are dropped, so playback goes on from the restored position right away
+bool RestoreMusicState(Music music, const void *state, unsigned int size)
+{
+    if ((music == NULL) || (state == NULL))
+        return false;
+
+    const MusicStateHeader *header = (const MusicStateHeader *)state;
+
+    if ((size != GetMusicStateSize(music)) || (header->magic != MUSIC_STATE_MAGIC) ||
+        (header->ctxType != (unsigned int)music->ctxType) || (header->engineSize != music->checkpointSize) ||
+        (header->moduleHash != music->moduleHash) || (header->sampleRate == 0) || (header->samplesLeft > header->totalSamples))
+    {
+        TraceLog(LOG_WARNING, "RestoreMusicState() : State doesn't belong to this music");
+        return false;
+    }
+
+    // NOTE: The fraction becomes whole frames when the music advances, anything out of [0, 1) is not a frame fraction
+    if (!((header->samplesFraction >= 0.0f) && (header->samplesFraction < 1.0f)))
+    {
+        TraceLog(LOG_WARNING, "RestoreMusicState() : State is corrupted, a position is out of the music");
+        return false;
+    }
+
+    AudioBuffer *audioBuffer = (AudioBuffer *)music->stream.audioBuffer;
+    bool restored = false;
+
+    if (audioBuffer != NULL)
+        LockAudioBufferRender(audioBuffer);
+
+    if (music->ctxType == MUSIC_MODULE_XM)
+        restored = (jar_xm_load_state(music->ctxXm, header + 1) == 0);
+    else if (music->ctxType == MUSIC_MODULE_MOD)
+        restored = jar_mod_load_state(&music->ctxMod, header + 1);
+
+    if (restored)
+    {
+        // Positions saved at another rate are moved to the rate of this music
+        unsigned int position = header->totalSamples - header->samplesLeft;
+
+        if (header->sampleRate != music->sampleRate)
+            position = (unsigned int)((double)position * music->sampleRate / header->sampleRate);
+
+        music->samplesLeft = (position < music->totalSamples) ? (music->totalSamples - position) : 0;
+        music->samplesFraction = header->samplesFraction;
+        music->renderFinished = false;
+
+        if (audioBuffer != NULL)
+            PushAudioCommand(AUDIO_COMMAND_FLUSH, audioBuffer, 0.0f);
+    }
+
+    if (audioBuffer != NULL)
+        UnlockAudioBufferRender(audioBuffer);
+
+    if (!restored)
+        TraceLog(LOG_WARNING, "RestoreMusicState() : State is corrupted, a position is out of the music");
+
+    return restored;
+}
+
+// Update (re-fill) music buffers if data already processed
+// TODO: Make sure buffers are ready for update... check music state
+void UpdateMusicStream(Music music)
+{
+    if (music == NULL)
+        return;
+
+    // Music rendered elsewhere only needs to be stopped here once it played to the end.
+    if (music->renderMode == MUSIC_RENDER_CALLBACK)
+    {
+        if (music->renderFinished)
+            StopMusicStream(music);
+
+        return;
+    }
+    else if (music->renderMode == MUSIC_RENDER_THREAD)
+    {
+        if (music->renderFinished && (GetAudioBufferFramesQueued((AudioBuffer *)music->stream.audioBuffer) == 0))
+            StopMusicStream(music);
+
+        return;
+    }
+
+    bool streamEnding = false;
+
+    unsigned int subBufferSizeInFrames = ((AudioBuffer *)music->stream.audioBuffer)->periodSizeInFrames;
+
+    // NOTE: The scratch buffer holds one period, it is allocated with the music because it could require more than 16KB
+    float *pcm = music->pcm;
+
+    int samplesCount = 0; // Total size of data steamed in L+R samples for xm floats, individual L or R for ogg shorts
+
+    ApplyMusicPitch(music);
+
+    while (IsAudioBufferProcessed(music->stream))
+    {
+        unsigned int framesLeft = GetMusicFramesLeft(music);
+
+        if ((framesLeft / music->stream.channels) >= subBufferSizeInFrames)
+            samplesCount = subBufferSizeInFrames * music->stream.channels;
+        else
+            samplesCount = framesLeft;
+
+        // NOTE: Both engines generate 2 channels, so samplesCount/2
+        GenerateMusicFrames(music, pcm, samplesCount / 2);
+
+        UpdateAudioStream(music->stream, pcm, samplesCount);
+        if ((music->ctxType == MUSIC_MODULE_XM) || (music->ctxType == MUSIC_MODULE_MOD))
+        {
+            if (samplesCount > 1)
+                AdvanceMusicPosition(music, samplesCount / 2);
+            else
+                AdvanceMusicPosition(music, samplesCount);
+        }
+        else
+            music->samplesLeft -= samplesCount;
+
+        if (music->samplesLeft <= 0)
+        {
+            streamEnding = true;
+            break;
+        }
+    }
+
+    // Reset audio stream for looping
+    if (streamEnding)
+    {
+        StopMusicStream(music); // Stop music (and reset)
 
-// Play an audio buffer
-// NOTE: Buffer is restarted to the start.
-// Use PauseAudioBuffer() and ResumeAudioBuffer() if the playback position should be maintained.
-void PlayAudioBuffer(AudioBuffer *audioBuffer)
-{
-    if (audioBuffer == NULL)
+        // Decrease loopCount to stop when required
+        if (music->loopCount > 0)
+        {
+            music->loopCount--;     // Decrease loop count
+            PlayMusicStream(music); // Play again
+        }
+        else
+        {
+            if (music->loopCount == -1)
+                PlayMusicStream(music);
+        }
+    }
+    else
     {
-        TraceLog(LOG_ERROR, "PlayAudioBuffer() : No audio buffer");
-        return;
+        // NOTE: In case window is minimized, music stream is stopped,
+        // just make sure to play again on window restore
+        if (IsMusicPlaying(music))
+            PlayMusicStream(music);
     }
+}
 
-    audioBuffer->playing = true;
-    audioBuffer->paused = false;
-    audioBuffer->frameCursorPos = 0;
+// Check if any music is playing
+bool IsMusicPlaying(Music music)
+{
+    if (music == NULL)
+        return false;
+    else
+        return IsAudioStreamPlaying(music->stream);
 }
 
-// Stop an audio buffer
-void StopAudioBuffer(AudioBuffer *audioBuffer)
+// Set volume for music
+void SetMusicVolume(Music music, float volume)
 {
-    if (audioBuffer == NULL)
+    if (music != NULL)
+        SetAudioStreamVolume(music->stream, volume);
+}
+
+// Set pitch for music
+// NOTE: Pitch and tempo change together. The engine picks it up on its next render, so it can be glided every frame.
+void SetMusicPitch(Music music, float pitch)
+{
+    if (music == NULL)
+        return;
+
+    if (!(pitch > 0.0f) || isinf(pitch))
     {
-        TraceLog(LOG_ERROR, "StopAudioBuffer() : No audio buffer");
+        TraceLog(LOG_WARNING, "SetMusicPitch() : Pitch must be a finite number greater than 0");
         return;
     }
 
-    // Don't do anything if the audio buffer is already stopped.
-    if (!IsAudioBufferPlaying(audioBuffer))
-        return;
+    // NOTE: Far out of range pitches would step the XM mixer beyond its samples
+    if (pitch < MUSIC_PITCH_MIN)
+        pitch = MUSIC_PITCH_MIN;
+    else if (pitch > MUSIC_PITCH_MAX)
+        pitch = MUSIC_PITCH_MAX;
 
-    audioBuffer->playing = false;
-    audioBuffer->paused = false;
-    audioBuffer->frameCursorPos = 0;
-    audioBuffer->isSubBufferProcessed[0] = true;
-    audioBuffer->isSubBufferProcessed[1] = true;
+    music->pitch = pitch;
 }
 
-// Pause an audio buffer
-void PauseAudioBuffer(AudioBuffer *audioBuffer)
+// Set music loop count (loop repeats)
+// NOTE: If set to -1, means infinite loop
+void SetMusicLoopCount(Music music, int count)
 {
-    if (audioBuffer == NULL)
-    {
-        TraceLog(LOG_ERROR, "PauseAudioBuffer() : No audio buffer");
+    if (music == NULL)
         return;
-    }
 
-    audioBuffer->paused = true;
+    AudioBuffer *audioBuffer = (AudioBuffer *)music->stream.audioBuffer;
+
+    if (audioBuffer != NULL)
+        LockAudioBufferRender(audioBuffer);
+
+    music->loopCount = count;
+
+    if (audioBuffer != NULL)
+        UnlockAudioBufferRender(audioBuffer);
 }
 
-// Resume an audio buffer
-void ResumeAudioBuffer(AudioBuffer *audioBuffer)
+// Set how XM samples are resampled to the output rate (MusicInterpolation)
+// NOTE: MusicInterpolation follows the jar_xm_interpolation_t order. MOD musics keep the jar_mod resampling.
+void SetMusicInterpolation(Music music, int interpolation)
 {
-    if (audioBuffer == NULL)
+    if (music == NULL)
+        return;
+
+    if ((interpolation < MUSIC_INTERPOLATION_NEAREST) || (interpolation > MUSIC_INTERPOLATION_SINC))
     {
-        TraceLog(LOG_ERROR, "ResumeAudioBuffer() : No audio buffer");
+        TraceLog(LOG_WARNING, "SetMusicInterpolation() : Unknown interpolation: %i", interpolation);
         return;
     }
 
-    audioBuffer->paused = false;
+    if (music->ctxType != MUSIC_MODULE_XM)
+        return;
+
+    AudioBuffer *audioBuffer = (AudioBuffer *)music->stream.audioBuffer;
+
+    if (audioBuffer != NULL)
+        LockAudioBufferRender(audioBuffer);
+
+    jar_xm_set_interpolation(music->ctxXm, (jar_xm_interpolation_t)interpolation);
+
+    if (audioBuffer != NULL)
+        UnlockAudioBufferRender(audioBuffer);
 }
 
-// Set volume for an audio buffer
-void SetAudioBufferVolume(AudioBuffer *audioBuffer, float volume)
+// Set where music frames are rendered (MusicRenderMode)
+// NOTE: MUSIC_RENDER_CALLBACK renders on the audio thread when the device asks for data and MUSIC_RENDER_THREAD keeps the
+// stream ring full from a worker thread, so playback no longer depends on UpdateMusicStream() being called often enough.
+// It can be switched while playing.
+void SetMusicRenderMode(Music music, int mode)
 {
+    if (music == NULL)
+        return;
+
+    AudioBuffer *audioBuffer = (AudioBuffer *)music->stream.audioBuffer;
+
     if (audioBuffer == NULL)
     {
-        TraceLog(LOG_WARNING, "SetAudioBufferVolume() : No audio buffer");
+        TraceLog(LOG_ERROR, "SetMusicRenderMode() : No audio buffer");
         return;
     }
 
-    audioBuffer->volume = volume;
-}
+    if ((mode != MUSIC_RENDER_UPDATE) && (mode != MUSIC_RENDER_CALLBACK) && (mode != MUSIC_RENDER_THREAD))
+    {
+        TraceLog(LOG_WARNING, "SetMusicRenderMode() : Unknown render mode: %i", mode);
+        return;
+    }
 
-// Set pitch for an audio buffer
-void SetAudioBufferPitch(AudioBuffer *audioBuffer, float pitch)
-{
-    if (audioBuffer == NULL)
+#if defined(MA_EMSCRIPTEN)
+    // No worker threads with Web Audio. The callback runs on the main thread, which is the closest match.
+    if (mode == MUSIC_RENDER_THREAD)
     {
-        TraceLog(LOG_WARNING, "SetAudioBufferPitch() : No audio buffer");
+        TraceLog(LOG_WARNING, "SetMusicRenderMode() : Render thread is not available, using callback rendering");
+        mode = MUSIC_RENDER_CALLBACK;
+    }
+#endif
+
+    if (music->renderMode == mode)
         return;
+
+    if ((mode == MUSIC_RENDER_THREAD) && (!StartMusicRenderThread() || !ReserveMusicRenderThread()))
+    {
+        TraceLog(LOG_WARNING, "SetMusicRenderMode() : Render thread is not available");
+        return;
+    }
+
+    // Once removed from the registry the worker won't touch this music anymore.
+    if (music->renderMode == MUSIC_RENDER_THREAD)
+        RegisterMusicRenderThread(music, false);
+
+    LockAudioBufferRender(audioBuffer);
+
+    if (mode == MUSIC_RENDER_CALLBACK)
+    {
+        audioBuffer->renderUserData = music;
+        audioBuffer->onRender = OnMusicRender;
     }
+    else
+    {
+        audioBuffer->onRender = NULL;
+        audioBuffer->renderUserData = NULL;
+    }
+
+    // Frames queued in the previous mode are stale, callback rendering would never even drain them.
+    PushAudioCommand(AUDIO_COMMAND_FLUSH, audioBuffer, 0.0f);
 
-    float pitchMul = pitch / audioBuffer->pitch;
+    music->renderMode = mode;
+    music->renderFinished = false;
 
-    // Pitching is just an adjustment of the sample rate. Note that this changes the duration of the sound - higher pitches
-    // will make the sound faster; lower pitches make it slower.
-    ma_uint32 newOutputSampleRate = (ma_uint32)((float)audioBuffer->dsp.src.config.sampleRateOut / pitchMul);
-    audioBuffer->pitch *= (float)audioBuffer->dsp.src.config.sampleRateOut / newOutputSampleRate;
+    UnlockAudioBufferRender(audioBuffer);
 
-    ma_pcm_converter_set_output_sample_rate(&audioBuffer->dsp, newOutputSampleRate);
+    if (mode == MUSIC_RENDER_THREAD)
+        RegisterMusicRenderThread(music, true);
 }
 
-// Track audio buffer to linked list next position
-void TrackAudioBuffer(AudioBuffer *audioBuffer)
+// Get music time length (in seconds)
+float GetMusicTimeLength(Music music)
+{
+    float totalSeconds = 0.0f;
+
+    if (music != NULL)
+        totalSeconds = (float)music->totalSamples / music->stream.sampleRate;
+
+    return totalSeconds;
+}
+
+// Get current music time played (in seconds)
+float GetMusicTimePlayed(Music music)
 {
-    ma_mutex_lock(&audioLock);
+    float secondsPlayed = 0.0f;
 
+    if (music != NULL)
     {
-        if (firstAudioBuffer == NULL)
-            firstAudioBuffer = audioBuffer;
-        else
+        unsigned int samplesPlayed = music->totalSamples - music->samplesLeft;
+
+        // Frames rendered ahead are still waiting in the stream ring, at the pitch they were rendered with.
+        // NOTE: Callback rendering plays frames as they are rendered, anything still in the ring is about to be flushed.
+        if (music->renderMode != MUSIC_RENDER_CALLBACK)
         {
-            lastAudioBuffer->next = audioBuffer;
-            audioBuffer->prev = lastAudioBuffer;
+            unsigned int samplesQueued = (unsigned int)(GetAudioBufferFramesQueued((AudioBuffer *)music->stream.audioBuffer) * music->enginePitch);
+            samplesPlayed = (samplesPlayed > samplesQueued) ? (samplesPlayed - samplesQueued) : 0;
         }
 
-        lastAudioBuffer = audioBuffer;
+        secondsPlayed = (float)samplesPlayed / music->stream.sampleRate;
     }
 
-    ma_mutex_unlock(&audioLock);
+    return secondsPlayed;
 }
 
-// Untrack audio buffer from linked list
-void UntrackAudioBuffer(AudioBuffer *audioBuffer)
+//----------------------------------------------------------------------------------
+// Module Functions Definition - Offline music rendering
+//----------------------------------------------------------------------------------
+// NOTE: Offline rendering drives the music engines directly, no audio device is required and frames are produced as
+// fast as the CPU allows. Every render owns its music, so a batch can be rendered in parallel from worker threads.
+#define MUSIC_RENDER_CHUNK_FRAMES 4096   // Frames rendered per engine call when writing to a file
+#define MUSIC_RENDER_DEFAULT_THREADS 4   // Workers of a batch render when none are requested
+#define MUSIC_RENDER_MAX_THREADS 16      // Maximum workers of a batch render
+
+// Open a music engine for offline rendering and get the number of frames to render
+// NOTE: loops is the loop count (0 plays once, -1 forever) and seconds cuts the render, 0 means no cut
+static Music OpenMusicRender(const char *fileName, unsigned int sampleRate, float seconds, int loops, ma_uint64 *frameCount)
 {
-    ma_mutex_lock(&audioLock);
+    if ((seconds <= 0.0f) && (loops < 0))
+    {
+        TraceLog(LOG_WARNING, "RenderMusic() : Endless render, set a length in seconds or a loop count [%s]", fileName);
+        return NULL;
+    }
+
+    Music music = (MusicData *)RL_MALLOC(sizeof(MusicData));
 
+    if (!LoadMusicModule(music, fileName, sampleRate))
     {
-        if (audioBuffer->prev == NULL)
-            firstAudioBuffer = audioBuffer->next;
-        else
-            audioBuffer->prev->next = audioBuffer->next;
+        RL_FREE(music);
+        return NULL;
+    }
 
-        if (audioBuffer->next == NULL)
-            lastAudioBuffer = audioBuffer->prev;
-        else
-            audioBuffer->next->prev = audioBuffer->prev;
+    music->loopCount = loops;
 
-        audioBuffer->prev = NULL;
-        audioBuffer->next = NULL;
+    ma_uint64 framesToRender = (seconds > 0.0f) ? (ma_uint64)(seconds * sampleRate) : 0;
+
+    if (loops >= 0)
+    {
+        ma_uint64 songFrames = (ma_uint64)music->totalSamples * (loops + 1);
+
+        if ((framesToRender == 0) || (songFrames < framesToRender))
+            framesToRender = songFrames;
     }
 
-    ma_mutex_unlock(&audioLock);
+    *frameCount = framesToRender;
+
+    return music;
 }
 
-//----------------------------------------------------------------------------------
-// Module Functions Definition - Music loading and stream playing (.OGG)
-//----------------------------------------------------------------------------------
-void jar_xm_reset(jar_xm_context_t* ctx)
+// Free a music opened by OpenMusicRender()
+static void CloseMusicRender(Music music)
 {
-    ctx->current_table_index = 0; //ctx->module.restart_position;
-    ctx->current_row = 0;
-    for (uint16_t i = 0; i < jar_xm_get_number_of_channels(ctx); i++)
-    {
-        jar_xm_cut_note(&ctx->channels[i]);
-         jar_xm_key_off(&ctx->channels[i]);
-      
-    }
+    UnloadMusicModule(music);
+    RL_FREE(music);
 }
 
-// Load music stream from file
-Music LoadMusicStream(const char *fileName)
+// Write little endian integers, independent of the host byte order
+static void WriteWaveU32(FILE *file, ma_uint32 value)
 {
-    Music music = (MusicData *)RL_MALLOC(sizeof(MusicData));
-    bool musicLoaded = true;
+    unsigned char bytes[4] = { (unsigned char)value, (unsigned char)(value >> 8), (unsigned char)(value >> 16), (unsigned char)(value >> 24) };
+    fwrite(bytes, 1, 4, file);
+}
 
-    if (IsFileExtension(fileName, ".xm"))
-    {
-        int result = jar_xm_create_context_from_file(&music->ctxXm, 48000, fileName);
+static void WriteWaveU16(FILE *file, ma_uint16 value)
+{
+    unsigned char bytes[2] = { (unsigned char)value, (unsigned char)(value >> 8) };
+    fwrite(bytes, 1, 2, file);
+}
 
-        if (!result) // XM context created successfully
-        {
+// Write the RIFF header of a 16bit PCM WAV file
+static void WriteWaveHeader(FILE *file, unsigned int sampleRate, unsigned int channels, ma_uint32 dataSize)
+{
+    fwrite("RIFF", 1, 4, file);
+    WriteWaveU32(file, 36 + dataSize);
+    fwrite("WAVEfmt ", 1, 8, file);
+    WriteWaveU32(file, 16);                           // fmt chunk size
+    WriteWaveU16(file, 1);                            // PCM
+    WriteWaveU16(file, (ma_uint16)channels);
+    WriteWaveU32(file, sampleRate);
+    WriteWaveU32(file, sampleRate * channels * 2);    // Bytes per second
+    WriteWaveU16(file, (ma_uint16)(channels * 2));    // Bytes per frame
+    WriteWaveU16(file, 16);                           // Bits per sample
+    fwrite("data", 1, 4, file);
+    WriteWaveU32(file, dataSize);
+}
 
-            jar_xm_set_max_loop_count(music->ctxXm, 0); // Set infinite number of loops
+// Render music into memory as interleaved stereo float frames
+// NOTE: sampleRate 0 renders at the default music rate. Free the result with UnloadWave()
+Wave RenderMusicWave(const char *fileName, unsigned int sampleRate, float seconds, int loops)
+{
+    Wave wave = { 0 };
+    ma_uint64 frameCount = 0;
 
-            // NOTE: Only stereo is supported for XM
-            music->stream = InitAudioStream(48000, 16, 2);
-            music->totalSamples = (unsigned int)jar_xm_get_remaining_samples(music->ctxXm);
-            music->samplesLeft = music->totalSamples;
-            music->ctxType = MUSIC_MODULE_XM;
-            music->loopCount = -1; // Infinite loop by default
-            jar_xm_reset(music->ctxXm);
-            TraceLog(LOG_INFO, "[%s] XM number of samples: %i", fileName, music->totalSamples);
-            TraceLog(LOG_INFO, "[%s] XM track length: %11.6f sec", fileName, (float)music->totalSamples / 48000.0f);
-        }
-        else
-        {
-            musicLoaded = false;
-        }
+    if (sampleRate == 0)
+        sampleRate = MUSIC_SAMPLE_RATE;
+
+    Music music = OpenMusicRender(fileName, sampleRate, seconds, loops, &frameCount);
+
+    if (music == NULL)
+        return wave;
+
+    // NOTE: Wave sample count is limited to 32bit
+    if (frameCount * 2 > 0xFFFFFFFF)
+    {
+        TraceLog(LOG_WARNING, "RenderMusicWave() : Render is too long for memory, render to a file instead [%s]", fileName);
+        CloseMusicRender(music);
+        return wave;
     }
-    else if (IsFileExtension(fileName, ".mod"))
+
+    float *data = (float *)RL_MALLOC((size_t)frameCount * 2 * sizeof(float));
+
+    if (data == NULL)
     {
-        jar_mod_init(&music->ctxMod);
+        TraceLog(LOG_ERROR, "RenderMusicWave() : Failed to allocate %u frames [%s]", (unsigned int)frameCount, fileName);
+        CloseMusicRender(music);
+        return wave;
+    }
 
-        if (jar_mod_load_file(&music->ctxMod, fileName))
-        {
+    ma_uint32 framesRendered = 0;
 
-            // NOTE: Only stereo is supported for MOD
-            music->stream = InitAudioStream(48000, 16, 2);
-            music->totalSamples = (unsigned int)jar_mod_max_samples(&music->ctxMod);
-            music->samplesLeft = music->totalSamples;
-            music->ctxType = MUSIC_MODULE_MOD;
-            music->loopCount = -1; // Infinite loop by default
+    while ((framesRendered < frameCount) && !music->renderFinished)
+        framesRendered += OnMusicRender(music, data + (framesRendered * 2), (ma_uint32)frameCount - framesRendered);
 
-            TraceLog(LOG_INFO, "[%s] MOD number of samples: %i", fileName, music->samplesLeft);
-            TraceLog(LOG_INFO, "[%s] MOD track length: %11.6f sec", fileName, (float)music->totalSamples / 48000.0f);
-        }
-        else
-        {
-            musicLoaded = false;
-        }
+    CloseMusicRender(music);
+
+    wave.sampleCount = framesRendered * 2;
+    wave.sampleRate = sampleRate;
+    wave.sampleSize = 32;
+    wave.channels = 2;
+    wave.data = data;
+
+    return wave;
+}
+
+// Unload wave data
+void UnloadWave(Wave wave)
+{
+    RL_FREE(wave.data);
+}
+
+// Render music into a 16bit stereo WAV file
+// NOTE: The file is written a chunk at a time, so length is only limited by the WAV format
+bool RenderMusicToFile(const char *fileName, const char *waveFileName, unsigned int sampleRate, float seconds, int loops)
+{
+    ma_uint64 frameCount = 0;
+
+    if (sampleRate == 0)
+        sampleRate = MUSIC_SAMPLE_RATE;
+
+    Music music = OpenMusicRender(fileName, sampleRate, seconds, loops, &frameCount);
+
+    if (music == NULL)
+        return false;
+
+    // NOTE: The RIFF size field is 32bit
+    if (frameCount * 4 > 0xFFFFFFFF - 36)
+    {
+        TraceLog(LOG_WARNING, "RenderMusicToFile() : Render is too long for a WAV file [%s]", fileName);
+        CloseMusicRender(music);
+        return false;
     }
 
-    else
+    FILE *file = OpenLocalFile(waveFileName, "wb");
+
+    if (file == NULL)
     {
-        musicLoaded = false;
+        TraceLog(LOG_WARNING, "RenderMusicToFile() : WAV file could not be created [%s]", waveFileName);
+        CloseMusicRender(music);
+        return false;
     }
 
-    if (!musicLoaded)
+    float *pcm = (float *)RL_MALLOC(MUSIC_RENDER_CHUNK_FRAMES * 2 * sizeof(float));
+    short *samples = (short *)RL_MALLOC(MUSIC_RENDER_CHUNK_FRAMES * 2 * sizeof(short));
+    unsigned char *bytes = (unsigned char *)samples;
+    ma_uint64 framesRendered = 0;
+    bool success = (pcm != NULL) && (samples != NULL);
+
+    // Sizes are patched once the render is done, a cut render may end early
+    WriteWaveHeader(file, sampleRate, 2, 0);
+
+    while (success && (framesRendered < frameCount) && !music->renderFinished)
     {
-        if (IsFileExtension(fileName, ".xm"))
-        {
+        ma_uint32 framesToRender = MUSIC_RENDER_CHUNK_FRAMES;
+        if (framesToRender > frameCount - framesRendered)
+            framesToRender = (ma_uint32)(frameCount - framesRendered);
 
-            jar_xm_free_context(music->ctxXm);
-        }
-        else if (IsFileExtension(fileName, ".mod"))
+        ma_uint32 frames = OnMusicRender(music, pcm, framesToRender);
+
+        for (ma_uint32 i = 0; i < frames * 2; i++)
         {
-            jar_mod_unload(&music->ctxMod);
+            float sample = pcm[i] * 32768.0f;
+
+            if (sample > 32767.0f)
+                sample = 32767.0f;
+            else if (sample < -32768.0f)
+                sample = -32768.0f;
+
+            ma_int16 value = (ma_int16)sample;
+            bytes[i * 2] = (unsigned char)value;
+            bytes[i * 2 + 1] = (unsigned char)((ma_uint16)value >> 8);
         }
 
-        RL_FREE(music);
-        music = NULL;
+        if (fwrite(bytes, 4, frames, file) != frames)
+            success = false;
 
-        TraceLog(LOG_WARNING, " Music file could not be opened [%s]", fileName);
+        framesRendered += frames;
     }
 
-    return music;
-}
+    if (success)
+    {
+        fseek(file, 0, SEEK_SET);
+        WriteWaveHeader(file, sampleRate, 2, (ma_uint32)(framesRendered * 4));
+    }
 
-// Unload music stream
-void UnloadMusicStream(Music music)
-{
-    if (music == NULL)
-        return;
+    if (fclose(file) != 0)
+        success = false;
 
-    CloseAudioStream(music->stream);
+    RL_FREE(samples);
+    RL_FREE(pcm);
+    CloseMusicRender(music);
 
-    if (music->ctxType == MUSIC_MODULE_XM)
-    {
-        jar_xm_free_context(music->ctxXm);
-    }
-    else if (music->ctxType == MUSIC_MODULE_MOD)
+    if (success)
+        TraceLog(LOG_INFO, "[%s] Rendered %u frames to [%s]", fileName, (unsigned int)framesRendered, waveFileName);
+    else
+        TraceLog(LOG_WARNING, "RenderMusicToFile() : Failed to write WAV file [%s]", waveFileName);
+
+    return success;
+}
+
+// Batch render shared by the workers, each one takes the next file until none is left
+typedef struct MusicRenderBatch
+{
+    const char **fileNames;
+    const char **waveFileNames;
+    int count;
+    unsigned int sampleRate;
+    float seconds;
+    int loops;
+
+    volatile ma_uint32 next;     // Next file to render, incremented by the workers
+    volatile ma_uint32 rendered; // Number of WAV files written
+} MusicRenderBatch;
+
+static void RenderMusicBatch(MusicRenderBatch *batch)
+{
+    for (;;)
     {
-        jar_mod_unload(&music->ctxMod);
+        ma_uint32 index = ma_atomic_increment_32(&batch->next) - 1;
+
+        if (index >= (ma_uint32)batch->count)
+            break;
+
+        if (RenderMusicToFile(batch->fileNames[index], batch->waveFileNames[index], batch->sampleRate, batch->seconds, batch->loops))
+            ma_atomic_increment_32(&batch->rendered);
     }
+}
 
-    RL_FREE(music);
+static ma_thread_result MA_THREADCALL MusicRenderBatchProc(void *pData)
+{
+    RenderMusicBatch((MusicRenderBatch *)pData);
+    return (ma_thread_result)0;
 }
 
-void UpdateVolume(Music music, float volume, float amplification)
+// Render a batch of musics into WAV files, in parallel on worker threads
+// NOTE: threads 0 uses the default worker count, the calling thread renders too. Returns the number of files written
+int RenderMusicToFiles(const char **fileNames, const char **waveFileNames, int count, unsigned int sampleRate, float seconds, int loops, int threads)
 {
+    MusicRenderBatch batch = { fileNames, waveFileNames, count, sampleRate, seconds, loops, 0, 0 };
 
-    if (music != NULL)
+    if (count <= 0)
+        return 0;
+
+    if (threads <= 0)
+        threads = MUSIC_RENDER_DEFAULT_THREADS;
+    if (threads > MUSIC_RENDER_MAX_THREADS)
+        threads = MUSIC_RENDER_MAX_THREADS;
+    if (threads > count)
+        threads = count;
+
+#if !defined(MA_EMSCRIPTEN)
+    // Worker threads need a context, the null backend doesn't touch any audio hardware
+    ma_context renderContext;
+    ma_thread workers[MUSIC_RENDER_MAX_THREADS];
+    int workerCount = 0;
+    ma_backend backends[] = { ma_backend_null };
+
+    if ((threads > 1) && (ma_context_init(backends, 1, NULL, &renderContext) == MA_SUCCESS))
     {
-        if (music->ctxType == MUSIC_MODULE_XM)
+        for (workerCount = 0; workerCount < threads - 1; workerCount++)
         {
-
-            music->ctxXm->global_volume = volume;
-            music->ctxXm->amplification = amplification; /* XXX: some bad modules may still clip. Find out something better. */
+            if (ma_thread_create(&renderContext, &workers[workerCount], MusicRenderBatchProc, &batch) != MA_SUCCESS)
+                break;
         }
+
+        RenderMusicBatch(&batch);
+
+        for (int i = 0; i < workerCount; i++)
+            ma_thread_wait(&workers[i]);
+
+        ma_context_uninit(&renderContext);
+    }
+    else
+#endif
+    {
+        RenderMusicBatch(&batch);
     }
+
+    return (int)batch.rendered;
 }
 
-// Start music playing (open stream)
-void PlayMusicStream(Music music) //, float volume, float amplification
-{
-    if (music != NULL)
-    {
-        AudioBuffer *audioBuffer = (AudioBuffer *)music->stream.audioBuffer;
+//----------------------------------------------------------------------------------
+// Module Functions Definition - Asynchronous music loading
+//----------------------------------------------------------------------------------
+// NOTE: Loader threads read, parse and measure modules, which is the slow part of loading. Only the audio stream is
+// created on the game thread, when the finished load is picked up by PollMusicStreamLoad().
+#define MUSIC_LOADER_THREADS 2 // Modules loaded at the same time
 
-        if (audioBuffer == NULL)
-        {
-            TraceLog(LOG_ERROR, "PlayMusicStream() : No audio buffer");
-            return;
-        }
+typedef struct MusicLoadJob
+{
+    char *fileName;
+    unsigned int sampleRate;
+    unsigned int bufferSizeInFrames;
+    unsigned int buffers;
+    void *userData;
 
-        // For music streams, we need to make sure we maintain the frame cursor position. This is hack for this section of code in UpdateMusicStream()
-        //     // NOTE: In case window is minimized, music stream is stopped,
-        //     // just make sure to play again on window restore
-        //     if (IsMusicPlaying(music)) PlayMusicStream(music);
-        ma_uint32 frameCursorPos = audioBuffer->frameCursorPos;
+    Music music; // Loaded engine, NULL if the module could not be loaded
+    struct MusicLoadJob *next;
+} MusicLoadJob;
 
-        // if (music->ctxType == MUSIC_MODULE_XM)
-        // {
+// Jobs move from the pending queue to the loaded queue, both are first in first out
+typedef struct MusicLoadQueue
+{
+    MusicLoadJob *first;
+    MusicLoadJob *last;
+} MusicLoadQueue;
+
+static ma_thread loaderThreads[MUSIC_LOADER_THREADS];
+static ma_event loaderSignals[MUSIC_LOADER_THREADS]; // One per thread, so a new job can wake all of them
+static ma_mutex loaderLock;
+static volatile bool loaderRunning = false;
+static MusicLoadQueue loaderPending = { NULL, NULL };
+static MusicLoadQueue loaderLoaded = { NULL, NULL };
+
+static void PushMusicLoadJob(MusicLoadQueue *queue, MusicLoadJob *job)
+{
+    job->next = NULL;
 
-        //     music->ctxXm->global_volume = volume;
-        //     music->ctxXm->amplification = amplification; /* XXX: some bad modules may still clip. Find out something better. */
-        // }
-        PlayAudioStream(music->stream); // <-- This resets the cursor position.
+    if (queue->last != NULL)
+        queue->last->next = job;
+    else
+        queue->first = job;
 
-        audioBuffer->frameCursorPos = frameCursorPos;
-    }
+    queue->last = job;
 }
 
-// Pause music playing
-void PauseMusicStream(Music music)
+static MusicLoadJob *PopMusicLoadJob(MusicLoadQueue *queue)
 {
-    if (music != NULL)
-        PauseAudioStream(music->stream);
+    MusicLoadJob *job = queue->first;
+
+    if (job != NULL)
+    {
+        queue->first = job->next;
+
+        if (queue->first == NULL)
+            queue->last = NULL;
+    }
+
+    return job;
 }
 
-// Resume music playing
-void ResumeMusicStream(Music music)
+// Load the music engine of a job
+static void LoadMusicJob(MusicLoadJob *job)
 {
-    if (music != NULL)
-        ResumeAudioStream(music->stream);
+    job->music = (MusicData *)RL_MALLOC(sizeof(MusicData));
+
+    if ((job->music != NULL) && !LoadMusicModule(job->music, job->fileName, job->sampleRate))
+    {
+        RL_FREE(job->music);
+        job->music = NULL;
+    }
 }
 
+static void FreeMusicLoadJob(MusicLoadJob *job)
+{
+    if (job->music != NULL)
+    {
+        UnloadMusicModule(job->music);
+        RL_FREE(job->music);
+    }
 
+    RL_FREE(job->fileName);
+    RL_FREE(job);
+}
 
-// Stop music playing (close stream)
-// TODO: To clear a buffer, make sure they have been already processed!
-void StopMusicStream(Music music)
+static ma_thread_result MA_THREADCALL MusicLoaderThreadProc(void *pData)
 {
-    if (music == NULL)
-        return;
-
-    StopAudioStream(music->stream);
+    ma_event *signal = (ma_event *)pData;
 
-    // Restart music context
-    switch (music->ctxType)
+    while (loaderRunning)
     {
+        ma_mutex_lock(&loaderLock);
+        MusicLoadJob *job = PopMusicLoadJob(&loaderPending);
+        ma_mutex_unlock(&loaderLock);
 
-    case MUSIC_MODULE_XM: /* TODO: Restart XM context */
-        jar_xm_reset(music->ctxXm);
-        break;
+        if (job == NULL)
+        {
+            ma_event_wait(signal);
+            continue;
+        }
 
-    case MUSIC_MODULE_MOD:
-        jar_mod_seek_start(&music->ctxMod);
-        break;
+        LoadMusicJob(job);
 
-    default:
-        break;
+        ma_mutex_lock(&loaderLock);
+        PushMusicLoadJob(&loaderLoaded, job);
+        ma_mutex_unlock(&loaderLock);
     }
 
-    music->samplesLeft = music->totalSamples;
+    return (ma_thread_result)0;
 }
 
-// Update (re-fill) music buffers if data already processed
-// TODO: Make sure buffers are ready for update... check music state
-void UpdateMusicStream(Music music)
+static bool StartMusicLoaderThreads(void)
 {
-    if (music == NULL)
-        return;
+    if (loaderRunning)
+        return true;
 
-    bool streamEnding = false;
-
-    unsigned int subBufferSizeInFrames = ((AudioBuffer *)music->stream.audioBuffer)->bufferSizeInFrames / 2;
-
-    // NOTE: Using dynamic allocation because it could require more than 16KB
-    void *pcm = RL_CALLOC(subBufferSizeInFrames * music->stream.channels * music->stream.sampleSize / 8, 1);
-
-    int samplesCount = 0; // Total size of data steamed in L+R samples for xm floats, individual L or R for ogg shorts
+#if defined(MA_EMSCRIPTEN)
+    return false;
+#else
+    if (!isAudioInitialized)
+        return false;
 
-    while (IsAudioBufferProcessed(music->stream))
+    if (ma_mutex_init(&context, &loaderLock) != MA_SUCCESS)
     {
-        if ((music->samplesLeft / music->stream.channels) >= subBufferSizeInFrames)
-            samplesCount = subBufferSizeInFrames * music->stream.channels;
-        else
-            samplesCount = music->samplesLeft;
+        TraceLog(LOG_ERROR, "Failed to create music loader lock");
+        return false;
+    }
 
-        // TODO: Really don't like ctxType thingy...
-        switch (music->ctxType)
-        {
+    loaderRunning = true;
 
-        case MUSIC_MODULE_XM:
-        {
-            // NOTE: Internally this function considers 2 channels generation, so samplesCount/2
-            jar_xm_generate_samples_16bit(music->ctxXm, (short *)pcm, samplesCount / 2);
-        }
-        break;
+    for (int i = 0; i < MUSIC_LOADER_THREADS; i++)
+    {
+        // A loader waits on its event whenever it runs out of jobs, it can't run without one.
+        bool signalCreated = (ma_event_init(&context, &loaderSignals[i]) == MA_SUCCESS);
 
-        case MUSIC_MODULE_MOD:
+        if (!signalCreated || (ma_thread_create(&context, &loaderThreads[i], MusicLoaderThreadProc, &loaderSignals[i]) != MA_SUCCESS))
         {
-            // NOTE: 3rd parameter (nbsample) specify the number of stereo 16bits samples you want, so sampleCount/2
-            jar_mod_fillbuffer(&music->ctxMod, (short *)pcm, samplesCount / 2, 0);
-        }
-        break;
-
-        default:
-            break;
-        }
+            TraceLog(LOG_ERROR, "Failed to create music loader threads");
+            if (signalCreated)
+                ma_event_uninit(&loaderSignals[i]);
+            loaderRunning = false;
 
-        UpdateAudioStream(music->stream, pcm, samplesCount);
-        if ((music->ctxType == MUSIC_MODULE_XM) || (music->ctxType == MUSIC_MODULE_MOD))
-        {
-            if (samplesCount > 1)
-                music->samplesLeft -= samplesCount / 2;
-            else
-                music->samplesLeft -= samplesCount;
-        }
-        else
-            music->samplesLeft -= samplesCount;
+            for (int j = 0; j < i; j++)
+            {
+                ma_event_signal(&loaderSignals[j]);
+                ma_thread_wait(&loaderThreads[j]);
+                ma_event_uninit(&loaderSignals[j]);
+            }
 
-        if (music->samplesLeft <= 0)
-        {
-            streamEnding = true;
-            break;
+            ma_mutex_uninit(&loaderLock);
+            return false;
         }
     }
 
-    // Free allocated pcm data
-    RL_FREE(pcm);
+    return true;
+#endif
+}
 
-    // Reset audio stream for looping
-    if (streamEnding)
+// Stop the loader threads and drop the loads nobody picked up
+static void StopMusicLoaderThreads(void)
+{
+    MusicLoadJob *job;
+
+    if (loaderRunning)
     {
-        StopMusicStream(music); // Stop music (and reset)
+        loaderRunning = false;
 
-        // Decrease loopCount to stop when required
-        if (music->loopCount > 0)
-        {
-            music->loopCount--;     // Decrease loop count
-            PlayMusicStream(music); // Play again
-        }
-        else
+        for (int i = 0; i < MUSIC_LOADER_THREADS; i++)
         {
-            if (music->loopCount == -1)
-                PlayMusicStream(music);
+            ma_event_signal(&loaderSignals[i]);
+            ma_thread_wait(&loaderThreads[i]);
+            ma_event_uninit(&loaderSignals[i]);
         }
+
+        ma_mutex_uninit(&loaderLock);
     }
-    else
-    {
-        // NOTE: In case window is minimized, music stream is stopped,
-        // just make sure to play again on window restore
-        if (IsMusicPlaying(music))
-            PlayMusicStream(music);
-    }
+
+    while ((job = PopMusicLoadJob(&loaderPending)) != NULL)
+        FreeMusicLoadJob(job);
+
+    while ((job = PopMusicLoadJob(&loaderLoaded)) != NULL)
+        FreeMusicLoadJob(job);
 }
 
-// Check if any music is playing
-bool IsMusicPlaying(Music music)
+// Load music stream from file in the background (game thread only)
+// NOTE: The music is handed back by PollMusicStreamLoad() with userData. Without loader threads (HTML5) musics are loaded
+// one per PollMusicStreamLoad() call instead
+bool LoadMusicStreamAsync(const char *fileName, unsigned int bufferSizeInFrames, unsigned int buffers, void *userData)
 {
-    if (music == NULL)
+    MusicLoadJob *job = (MusicLoadJob *)RL_MALLOC(sizeof(MusicLoadJob));
+    size_t fileNameSize = strlen(fileName) + 1;
+
+    if (job == NULL)
         return false;
-    else
-        return IsAudioStreamPlaying(music->stream);
-}
 
-// Set volume for music
-void SetMusicVolume(Music music, float volume)
-{
-    if (music != NULL)
-        SetAudioStreamVolume(music->stream, volume);
-}
+    job->fileName = (char *)RL_MALLOC(fileNameSize);
 
-// Set pitch for music
-void SetMusicPitch(Music music, float pitch)
-{
-    if (music != NULL)
-        SetAudioStreamPitch(music->stream, pitch);
-}
+    if (job->fileName == NULL)
+    {
+        RL_FREE(job);
+        return false;
+    }
 
-// Set music loop count (loop repeats)
-// NOTE: If set to -1, means infinite loop
-void SetMusicLoopCount(Music music, int count)
-{
-    if (music != NULL)
-        music->loopCount = count;
-}
+    memcpy(job->fileName, fileName, fileNameSize);
+    job->sampleRate = GetMusicSampleRate();
+    job->bufferSizeInFrames = bufferSizeInFrames;
+    job->buffers = buffers;
+    job->userData = userData;
+    job->music = NULL;
 
-// Get music time length (in seconds)
-float GetMusicTimeLength(Music music)
-{
-    float totalSeconds = 0.0f;
+    if (StartMusicLoaderThreads())
+    {
+        ma_mutex_lock(&loaderLock);
+        PushMusicLoadJob(&loaderPending, job);
+        ma_mutex_unlock(&loaderLock);
 
-    if (music != NULL)
-        totalSeconds = (float)music->totalSamples / (music->stream.sampleRate * music->stream.channels);
+        for (int i = 0; i < MUSIC_LOADER_THREADS; i++)
+            ma_event_signal(&loaderSignals[i]);
+    }
+    else
+    {
+        PushMusicLoadJob(&loaderPending, job);
+    }
 
-    return totalSeconds;
+    return true;
 }
 
-// Get current music time played (in seconds)
-float GetMusicTimePlayed(Music music)
+// Get a music loaded by LoadMusicStreamAsync() (game thread only)
+// NOTE: Returns false when no load has finished. A finished load sets music, or NULL if the file could not be loaded
+bool PollMusicStreamLoad(Music *music, void **userData)
 {
-    float secondsPlayed = 0.0f;
+    MusicLoadJob *job;
 
-    if (music != NULL)
+    if (loaderRunning)
     {
-        unsigned int samplesPlayed = music->totalSamples - music->samplesLeft;
-        secondsPlayed = (float)samplesPlayed / (music->stream.sampleRate * music->stream.channels);
+        ma_mutex_lock(&loaderLock);
+        job = PopMusicLoadJob(&loaderLoaded);
+        ma_mutex_unlock(&loaderLock);
+    }
+    else
+    {
+        job = PopMusicLoadJob(&loaderPending);
+
+        if (job != NULL)
+            LoadMusicJob(job);
     }
 
-    return secondsPlayed;
+    if (job == NULL)
+        return false;
+
+    *music = (job->music != NULL) ? OpenMusicStream(job->music, job->bufferSizeInFrames, job->buffers) : NULL;
+    *userData = job->userData;
+
+    job->music = NULL; // Owned by the caller now
+    FreeMusicLoadJob(job);
+
+    return true;
 }
 
 // Init audio stream (to stream audio pcm data)
 AudioStream InitAudioStream(unsigned int sampleRate, unsigned int sampleSize, unsigned int channels)
+{
+    return InitAudioStreamEx(sampleRate, sampleSize, channels, 0, 0);
+}
+
+// Init audio stream with its own buffer geometry
+// NOTE: bufferSizeInFrames is the refill period and buffers the number of periods in the ring, 0 uses the defaults.
+// The ring is allocated once here, small periods trade memory for latency.
+AudioStream InitAudioStreamEx(unsigned int sampleRate, unsigned int sampleSize, unsigned int channels, unsigned int bufferSizeInFrames, unsigned int buffers)
 {
     AudioStream stream = {0};
 
@@ -1066,23 +3396,37 @@ AudioStream InitAudioStream(unsigned int sampleRate, unsigned int sampleSize, un
 
     ma_format formatIn = ((stream.sampleSize == 8) ? ma_format_u8 : ((stream.sampleSize == 16) ? ma_format_s16 : ma_format_f32));
 
-    // The size of a streaming buffer must be at least double the size of a period.
+    unsigned int subBufferSize = (bufferSizeInFrames > 0) ? bufferSizeInFrames : streamBufferSizeInFrames;
+    if (subBufferSize < MIN_AUDIO_BUFFER_SIZE)
+        subBufferSize = MIN_AUDIO_BUFFER_SIZE;
+    else if (subBufferSize > MAX_AUDIO_BUFFER_SIZE)
+        subBufferSize = MAX_AUDIO_BUFFER_SIZE;
+
+    unsigned int subBufferCount = (buffers > 0) ? buffers : streamBufferPeriods;
+    if (subBufferCount < MAX_STREAM_BUFFERS)
+        subBufferCount = MAX_STREAM_BUFFERS;
+    else if (subBufferCount > MAX_STREAM_PERIODS)
+        subBufferCount = MAX_STREAM_PERIODS;
+
+    // The size of a streaming buffer must be at least double the size of a device period.
+    // Short buffers keep their refill granularity and get more of them instead.
     unsigned int periodSize = device.playback.internalBufferSizeInFrames / device.playback.internalPeriods;
-    unsigned int subBufferSize = AUDIO_BUFFER_SIZE;
-    if (subBufferSize < periodSize)
-        subBufferSize = periodSize;
+    while ((subBufferSize * subBufferCount) < (periodSize * 2))
+        subBufferCount++;
 
-    AudioBuffer *audioBuffer = CreateAudioBuffer(formatIn, stream.channels, stream.sampleRate, subBufferSize * 2, AUDIO_BUFFER_USAGE_STREAM);
+    AudioBuffer *audioBuffer = CreateAudioBuffer(formatIn, stream.channels, stream.sampleRate, subBufferSize * subBufferCount, AUDIO_BUFFER_USAGE_STREAM);
     if (audioBuffer == NULL)
     {
         TraceLog(LOG_ERROR, "InitAudioStream() : Failed to create audio buffer");
         return stream;
     }
 
+    audioBuffer->periodSizeInFrames = subBufferSize;
     audioBuffer->looping = true; // Always loop for streaming buffers.
     stream.audioBuffer = audioBuffer;
 
     TraceLog(LOG_INFO, "[AUD ID %i] Audio stream loaded successfully (%i Hz, %i bit, %s)", stream.source, stream.sampleRate, stream.sampleSize, (stream.channels == 1) ? "Mono" : "Stereo");
+    TraceLog(LOG_DEBUG, "[AUD ID %i] Audio stream buffers: %i x %i frames", stream.source, subBufferCount, subBufferSize);
 
     return stream;
 }
@@ -1096,8 +3440,8 @@ void CloseAudioStream(AudioStream stream)
 }
 
 // Update audio stream buffers with data
-// NOTE 1: Only updates one buffer of the stream source: unqueue -> update -> queue
-// NOTE 2: To unqueue a buffer it needs to be processed: IsAudioBufferProcessed()
+// NOTE 1: Appends the data to the stream ring, which holds a number of periods (see SetAudioStreamBufferPeriods())
+// NOTE 2: To append data there must be room for it: IsAudioBufferProcessed()
 void UpdateAudioStream(AudioStream stream, const void *data, int samplesCount)
 {
     AudioBuffer *audioBuffer = (AudioBuffer *)stream.audioBuffer;
@@ -1107,57 +3451,27 @@ void UpdateAudioStream(AudioStream stream, const void *data, int samplesCount)
         return;
     }
 
-    if (audioBuffer->isSubBufferProcessed[0] || audioBuffer->isSubBufferProcessed[1])
-    {
-        ma_uint32 subBufferToUpdate;
-
-        if (audioBuffer->isSubBufferProcessed[0] && audioBuffer->isSubBufferProcessed[1])
-        {
-            // Both buffers are available for updating. Update the first one and make sure the cursor is moved back to the front.
-            subBufferToUpdate = 0;
-            audioBuffer->frameCursorPos = 0;
-        }
-        else
-        {
-            // Just update whichever sub-buffer is processed.
-            subBufferToUpdate = (audioBuffer->isSubBufferProcessed[0]) ? 0 : 1;
-        }
-
-        ma_uint32 subBufferSizeInFrames = audioBuffer->bufferSizeInFrames / 2;
-        unsigned char *subBuffer = audioBuffer->buffer + ((subBufferSizeInFrames * stream.channels * (stream.sampleSize / 8)) * subBufferToUpdate);
-
-        // Does this API expect a whole buffer to be updated in one go? Assuming so, but if not will need to change this logic.
-        if (subBufferSizeInFrames >= (ma_uint32)samplesCount / stream.channels)
-        {
-            ma_uint32 framesToWrite = subBufferSizeInFrames;
-
-            if (framesToWrite > ((ma_uint32)samplesCount / stream.channels))
-                framesToWrite = (ma_uint32)samplesCount / stream.channels;
-
-            ma_uint32 bytesToWrite = framesToWrite * stream.channels * (stream.sampleSize / 8);
-            memcpy(subBuffer, data, bytesToWrite);
-
-            // Any leftover frames should be filled with zeros.
-            ma_uint32 leftoverFrameCount = subBufferSizeInFrames - framesToWrite;
-
-            if (leftoverFrameCount > 0)
-            {
-                memset(subBuffer + bytesToWrite, 0, leftoverFrameCount * stream.channels * (stream.sampleSize / 8));
-            }
+    ma_uint32 framesToWrite = (ma_uint32)samplesCount / stream.channels;
+    ma_uint32 framesFree = audioBuffer->bufferSizeInFrames - GetAudioBufferFramesQueued(audioBuffer);
 
-            audioBuffer->isSubBufferProcessed[subBufferToUpdate] = false;
-        }
-        else
-        {
-            TraceLog(LOG_ERROR, "UpdateAudioStream() : Attempting to write too many frames to buffer");
-            return;
-        }
-    }
-    else
+    if (framesToWrite > framesFree)
     {
-        TraceLog(LOG_ERROR, "Audio buffer not available for updating");
+        TraceLog(LOG_ERROR, "UpdateAudioStream() : Attempting to write too many frames to buffer");
         return;
     }
+
+    ma_uint32 frameSize = stream.channels * (stream.sampleSize / 8);
+    ma_uint32 write = audioBuffer->writeFrame;
+    ma_uint32 firstFrame = write % audioBuffer->bufferSizeInFrames;
+    ma_uint32 firstPart = audioBuffer->bufferSizeInFrames - firstFrame;
+    if (firstPart > framesToWrite)
+        firstPart = framesToWrite;
+
+    memcpy(audioBuffer->buffer + (firstFrame * frameSize), data, firstPart * frameSize);
+    memcpy(audioBuffer->buffer, (const unsigned char *)data + (firstPart * frameSize), (framesToWrite - firstPart) * frameSize);
+
+    ma_memory_barrier(); // Publish the frames before moving the write cursor.
+    audioBuffer->writeFrame = (write + framesToWrite) % (audioBuffer->bufferSizeInFrames * 2);
 }
 
 // Check if any audio stream buffers requires refill
@@ -1170,7 +3484,21 @@ bool IsAudioBufferProcessed(AudioStream stream)
         return false;
     }
 
-    return audioBuffer->isSubBufferProcessed[0] || audioBuffer->isSubBufferProcessed[1];
+    // There is room for at least one more period.
+    return (audioBuffer->bufferSizeInFrames - GetAudioBufferFramesQueued(audioBuffer)) >= audioBuffer->periodSizeInFrames;
+}
+
+// Set the ring size of audio streams created from now on, in buffers (render-ahead depth)
+// NOTE: Values are clamped when the stream is created
+void SetAudioStreamBufferPeriods(unsigned int periods)
+{
+    streamBufferPeriods = (periods > 0) ? periods : MAX_STREAM_BUFFERS;
+}
+
+// Set the buffer (refill period) size of audio streams created from now on, in frames
+void SetAudioStreamBufferSizeDefault(unsigned int size)
+{
+    streamBufferSizeInFrames = (size > 0) ? size : AUDIO_BUFFER_SIZE;
 }
 
 // Play audio stream
@@ -1213,6 +3541,35 @@ void SetAudioStreamPitch(AudioStream stream, float pitch)
     SetAudioBufferPitch((AudioBuffer *)stream.audioBuffer, pitch);
 }
 
+#if defined(RAUDIO_COUNT_ALLOCATIONS)
+// Heap allocations made through RL_MALLOC()/RL_CALLOC()/RL_REALLOC() so far
+static volatile unsigned int audioAllocationCount = 0;
+static volatile unsigned int audioThreadAllocationCount = 0;
+
+void CountAudioAllocation(void)
+{
+    audioAllocationCount++;
+
+    // Real-time threads must get everything they need before playback starts.
+    if (isAudioThread)
+    {
+        audioThreadAllocationCount++;
+        TraceLog(LOG_ERROR, "CountAudioAllocation() : Allocation on the audio thread");
+        assert(!"Allocation on the audio thread");
+    }
+}
+
+unsigned int GetAudioAllocationCount(void)
+{
+    return audioAllocationCount;
+}
+
+unsigned int GetAudioThreadAllocationCount(void)
+{
+    return audioThreadAllocationCount;
+}
+#endif
+
 //----------------------------------------------------------------------------------
 // Module specific Functions Definition
 //----------------------------------------------------------------------------------
@@ -0,0 +1,88 @@
+// Plays modules in every render mode and checks that nothing is allocated once playback has started.
+// NOTE: Built with RAUDIO_COUNT_ALLOCATIONS, an allocation by the mixer or the render-ahead thread also fails an assert.
+#include "raudio.c"
+
+#define PLAY_MILLISECONDS 1500
+#define WARM_UP_MILLISECONDS 300
+#define UPDATE_MILLISECONDS 5
+
+static const char *moduleFiles[] = {
+    "../res/common/assets/test_1.xm",
+    "../res/common/assets/test_4.mod"
+};
+
+int main(void)
+{
+    const int renderModes[] = { MUSIC_RENDER_UPDATE, MUSIC_RENDER_CALLBACK, MUSIC_RENDER_THREAD };
+    Music musics[sizeof(moduleFiles) / sizeof(moduleFiles[0])][sizeof(renderModes) / sizeof(renderModes[0])];
+    int musicCount = 0;
+    int failures = 0;
+
+    InitAudioDevice();
+    if (!IsAudioDeviceReady())
+    {
+        printf("audio_thread_alloc: no audio device, skipped\n");
+        return 77;
+    }
+
+    for (int f = 0; f < (int)(sizeof(moduleFiles) / sizeof(moduleFiles[0])); f++)
+    {
+        for (int m = 0; m < (int)(sizeof(renderModes) / sizeof(renderModes[0])); m++)
+        {
+            Music music = LoadMusicStream(moduleFiles[f]);
+            if (music == NULL)
+            {
+                printf("audio_thread_alloc: failed to load %s\n", moduleFiles[f]);
+                return 1;
+            }
+
+            SetMusicRenderMode(music, renderModes[m]);
+            PlayMusicStream(music);
+            musics[f][m] = music;
+            musicCount++;
+        }
+    }
+
+    Music *allMusics = &musics[0][0];
+    unsigned int warmAllocations = 0;
+
+    for (int elapsed = 0; elapsed < PLAY_MILLISECONDS; elapsed += UPDATE_MILLISECONDS)
+    {
+        if (elapsed == WARM_UP_MILLISECONDS)
+            warmAllocations = GetAudioAllocationCount();
+
+        // Commands and engine updates from the game thread must not allocate either.
+        for (int i = 0; i < musicCount; i++)
+        {
+            if (elapsed % 100 == 0)
+                SetMusicVolume(allMusics[i], 0.5f + (float)(elapsed % 200) / 400.0f);
+            if (elapsed == PLAY_MILLISECONDS / 2)
+                SetMusicPitch(allMusics[i], 1.5f);
+
+            UpdateMusicStream(allMusics[i]);
+        }
+
+        ma_sleep(UPDATE_MILLISECONDS);
+    }
+
+    if (GetAudioThreadAllocationCount() != 0)
+    {
+        printf("audio_thread_alloc: %u allocations on the audio threads\n", GetAudioThreadAllocationCount());
+        failures++;
+    }
+
+    if (GetAudioAllocationCount() != warmAllocations)
+    {
+        printf("audio_thread_alloc: %u allocations after warm-up\n", GetAudioAllocationCount() - warmAllocations);
+        failures++;
+    }
+
+    printf("audio_thread_alloc: %i musics, %u allocations before warm-up, %i failures\n", musicCount, warmAllocations, failures);
+
+    for (int i = 0; i < musicCount; i++)
+        UnloadMusicStream(allMusics[i]);
+
+    CloseAudioDevice();
+
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,292 @@
+// Floods the mixer command queue while the audio thread runs and checks that no command is lost or applied out of order.
+// Modules are loaded and unloaded all along, the time between callbacks and the time each takes are reported as jitter.
+// NOTE: raudio.c is included directly to reach the mixer state, the voices are checked from the audio callback itself.
+// Its AudioBuffer alias ends with the file, the struct is rAudioBuffer here.
+#include "raudio.c"
+
+#define FIXED_BUFFERS (3 * AUDIO_VOICES_INITIAL_CAPACITY) // Enough to make the mixer grow its voice array twice
+#define CHURN_BUFFERS 32
+#define CHURN_MUSICS 4
+#define ROUNDS 200
+#define ROUND_MILLISECONDS 5
+#define TIMED_CALLBACKS 4096
+
+static const char *musicFiles[] = {
+    "../res/common/assets/test_1.xm", "../res/common/assets/test_4.mod", "../res/common/assets/test_7.xm",
+    "../res/common/assets/test_6.mod", "../res/common/assets/test_22.xm", "../res/common/assets/test_20.mod"
+};
+
+static rAudioBuffer *fixedBuffers[FIXED_BUFFERS];
+static float postedVolumes[FIXED_BUFFERS];
+static float mixedVolumes[FIXED_BUFFERS]; // Audio thread only
+static volatile ma_uint32 mixerErrors = 0;
+static ma_device_callback_proc mixerCallback;
+static ma_timer callbackTimer;
+static double callbackStarts[TIMED_CALLBACKS]; // Audio thread only, until the mix is done
+static double callbackTimes[TIMED_CALLBACKS];
+static volatile ma_uint32 timedCallbacks = 0;
+
+static int FindFixedBuffer(rAudioBuffer *audioBuffer)
+{
+    for (int i = 0; i < FIXED_BUFFERS; i++)
+    {
+        if (fixedBuffers[i] == audioBuffer)
+            return i;
+    }
+
+    return -1;
+}
+
+// Run the mixer, then check every voice against what it saw in the previous callbacks (audio thread)
+static void OnCheckedMix(ma_device *pDevice, void *pFramesOut, const void *pFramesInput, ma_uint32 frameCount)
+{
+    double start = ma_timer_get_time_in_seconds(&callbackTimer);
+    mixerCallback(pDevice, pFramesOut, pFramesInput, frameCount);
+
+    if (timedCallbacks < TIMED_CALLBACKS)
+    {
+        callbackStarts[timedCallbacks] = start;
+        callbackTimes[timedCallbacks] = ma_timer_get_time_in_seconds(&callbackTimer) - start;
+        timedCallbacks++;
+    }
+
+    for (ma_uint32 iVoice = 0; iVoice < audioVoiceCount; iVoice++)
+    {
+        AudioVoice *voice = &audioVoices->voices[iVoice];
+
+        if (voice->audioBuffer->voiceIndex != (int)iVoice)
+            mixerErrors++;
+
+        int i = FindFixedBuffer(voice->audioBuffer);
+        if (i < 0)
+            continue;
+
+        // Volumes are posted in increasing order, a smaller one means a command was applied late.
+        if (voice->volume < mixedVolumes[i])
+            mixerErrors++;
+
+        mixedVolumes[i] = voice->volume;
+    }
+}
+
+static rAudioBuffer *CreateTestBuffer(bool looping)
+{
+    rAudioBuffer *audioBuffer = CreateAudioBuffer(ma_format_f32, DEVICE_CHANNELS, device.sampleRate, 1024, AUDIO_BUFFER_USAGE_STATIC);
+
+    if (audioBuffer != NULL)
+        audioBuffer->looping = looping;
+
+    return audioBuffer;
+}
+
+static int CompareTimes(const void *a, const void *b)
+{
+    double difference = *(const double *)a - *(const double *)b;
+    return (difference > 0.0) - (difference < 0.0);
+}
+
+// Sort the times and print the largest one and the 99th percentile, in milliseconds
+static void PrintTimes(const char *name, double *times, ma_uint32 count)
+{
+    qsort(times, count, sizeof(double), CompareTimes);
+    printf("command_queue: %s p99 %.2f ms, max %.2f ms\n", name, times[(count - 1) * 99 / 100] * 1000.0, times[count - 1] * 1000.0);
+}
+
+// Report how far the callbacks strayed from their median period and how long the mix took
+// NOTE: The null backend polls its clock every 10ms and catches up with back to back callbacks, up to a period of jitter is its own.
+static void PrintCallbackJitter(void)
+{
+    ma_uint32 count = timedCallbacks;
+    if (count < 3)
+    {
+        printf("command_queue: only %u callbacks timed\n", count);
+        return;
+    }
+
+    static double intervals[TIMED_CALLBACKS];
+    for (ma_uint32 i = 1; i < count; i++)
+        intervals[i - 1] = callbackStarts[i] - callbackStarts[i - 1];
+
+    qsort(intervals, count - 1, sizeof(double), CompareTimes);
+    double period = intervals[(count - 1) / 2];
+    for (ma_uint32 i = 0; i < count - 1; i++)
+        intervals[i] = fabs(intervals[i] - period);
+
+    printf("command_queue: %u callbacks, period %.2f ms\n", count, period * 1000.0);
+    PrintTimes("callback jitter", intervals, count - 1);
+    PrintTimes("callback time", callbackTimes, count);
+}
+
+static void WaitForMixer(void)
+{
+    while (audioCommandRead != audioCommandWrite)
+        ma_sleep(1);
+
+    // The callback that applied the last command has also been checked once two more have started.
+    ma_uint32 epoch = mixerEpoch;
+    while ((ma_int32)(mixerEpoch - epoch) < 2)
+        ma_sleep(1);
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    InitAudioDevice();
+    if (!IsAudioDeviceReady())
+    {
+        printf("command_queue: no audio device, skipped\n");
+        return 77;
+    }
+
+    ma_timer_init(&callbackTimer);
+    mixerCallback = device.onData;
+    device.onData = OnCheckedMix;
+
+    rAudioBuffer *churnBuffers[CHURN_BUFFERS] = { 0 };
+    Music churnMusics[CHURN_MUSICS] = { 0 };
+    int musicLoads = 0;
+    bool playing[FIXED_BUFFERS] = { 0 };
+    bool paused[FIXED_BUFFERS] = { 0 };
+    ma_uint32 commands = audioCommandWrite;
+
+    for (int i = 0; i < FIXED_BUFFERS; i++)
+    {
+        fixedBuffers[i] = CreateTestBuffer(true);
+        postedVolumes[i] = 1.0f;
+    }
+
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        for (int i = 0; i < FIXED_BUFFERS; i++)
+        {
+            postedVolumes[i] += 1.0f;
+            SetAudioBufferVolume(fixedBuffers[i], postedVolumes[i]);
+
+            switch ((round + i) % 7)
+            {
+            case 0:
+            case 2: PlayAudioBuffer(fixedBuffers[i]); playing[i] = true; paused[i] = false; break;
+            case 3: PauseAudioBuffer(fixedBuffers[i]); paused[i] = true; break;
+            case 4: ResumeAudioBuffer(fixedBuffers[i]); paused[i] = false; break;
+            case 5: if (playing[i] && !paused[i]) { StopAudioBuffer(fixedBuffers[i]); playing[i] = false; } break;
+            default: break;
+            }
+        }
+
+        // Track and untrack buffers in between, the mixer swaps voices around on every untrack.
+        int c = round % CHURN_BUFFERS;
+        if (churnBuffers[c] != NULL)
+            DeleteAudioBuffer(churnBuffers[c]);
+        churnBuffers[c] = CreateTestBuffer(false);
+        PlayAudioBuffer(churnBuffers[c]);
+
+        // Modules too, half of them rendered by the audio callback itself.
+        int m = round % CHURN_MUSICS;
+        if (churnMusics[m] != NULL)
+            UnloadMusicStream(churnMusics[m]);
+
+        const char *fileName = musicFiles[round % (sizeof(musicFiles) / sizeof(musicFiles[0]))];
+        churnMusics[m] = LoadMusicStream(fileName);
+        if (churnMusics[m] == NULL)
+        {
+            printf("command_queue: failed to load %s\n", fileName);
+            failures++;
+        }
+        else
+        {
+            SetMusicRenderMode(churnMusics[m], ((round / CHURN_MUSICS) % 2) ? MUSIC_RENDER_CALLBACK : MUSIC_RENDER_UPDATE);
+            PlayMusicStream(churnMusics[m]);
+            musicLoads++;
+        }
+
+        for (m = 0; m < CHURN_MUSICS; m++)
+        {
+            if (churnMusics[m] != NULL)
+                UpdateMusicStream(churnMusics[m]);
+        }
+
+        ma_sleep(ROUND_MILLISECONDS);
+    }
+
+    for (int m = 0; m < CHURN_MUSICS; m++)
+    {
+        if (churnMusics[m] != NULL)
+            UnloadMusicStream(churnMusics[m]);
+    }
+
+    commands = audioCommandWrite - commands;
+    WaitForMixer();
+
+    // Every command must have been applied, the last one of each kind wins.
+    ma_uint32 liveBuffers = FIXED_BUFFERS;
+    for (int c = 0; c < CHURN_BUFFERS; c++)
+        liveBuffers += (churnBuffers[c] != NULL);
+
+    if (audioVoiceCount != liveBuffers)
+    {
+        printf("command_queue: %u voices for %u buffers\n", audioVoiceCount, liveBuffers);
+        failures++;
+    }
+
+    for (int i = 0; i < FIXED_BUFFERS; i++)
+    {
+        rAudioBuffer *audioBuffer = fixedBuffers[i];
+
+        if ((audioBuffer->voiceIndex < 0) || (audioVoices->voices[audioBuffer->voiceIndex].audioBuffer != audioBuffer))
+        {
+            printf("command_queue: buffer %i lost its voice\n", i);
+            failures++;
+            continue;
+        }
+
+        // Plays are counted on both sides, so a lost one shows even when a later command hides it.
+        AudioVoice *voice = &audioVoices->voices[audioBuffer->voiceIndex];
+        if ((voice->volume != postedVolumes[i]) || (voice->playing != playing[i]) || (voice->playing && (voice->paused != paused[i])) ||
+            (voice->playCount != audioBuffer->playCount))
+        {
+            printf("command_queue: buffer %i has volume %g playing %i paused %i plays %u, expected %g %i %i %u\n", i,
+                   voice->volume, voice->playing, voice->paused, voice->playCount,
+                   postedVolumes[i], playing[i], paused[i], audioBuffer->playCount);
+            failures++;
+        }
+    }
+
+    if (mixerErrors > 0)
+    {
+        printf("command_queue: %u voices out of order in the mixer\n", mixerErrors);
+        failures++;
+    }
+
+    // A non looping buffer stops by itself and reports it, until it is played again.
+    rAudioBuffer *oneShot = CreateTestBuffer(false);
+    PlayAudioBuffer(oneShot);
+    WaitForMixer();
+    ma_sleep(100);
+
+    if (IsAudioBufferPlaying(oneShot))
+    {
+        printf("command_queue: non looping buffer still playing after its end\n");
+        failures++;
+    }
+
+    PlayAudioBuffer(oneShot);
+    if (!IsAudioBufferPlaying(oneShot))
+    {
+        printf("command_queue: non looping buffer not playing after a new play\n");
+        failures++;
+    }
+
+    PrintCallbackJitter();
+    printf("command_queue: %u commands, %i module loads, %u voices, %i failures\n", commands, musicLoads, audioVoiceCount, failures);
+
+    for (int i = 0; i < FIXED_BUFFERS; i++)
+        DeleteAudioBuffer(fixedBuffers[i]);
+    for (int c = 0; c < CHURN_BUFFERS; c++)
+        DeleteAudioBuffer(churnBuffers[c]);
+    DeleteAudioBuffer(oneShot);
+
+    CloseAudioDevice();
+
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+// Renders the bundled XM files with the float mixer and with the fixed point one (JAR_XM_FIXED_POINT) and checks that they agree.
+// NOTE: The mixer is chosen at build time, so this file is built twice. The float build writes its renders as references,
+// the fixed point build renders again, compares and deletes them: the error must stay XM_TOLERANCE_DB below the music.
+#include "raudio.c"
+
+#define XM_SECONDS 30.0f
+#define XM_SAMPLE_RATE 48000
+#define XM_TOLERANCE_DB 65.0
+
+static const char *xmFiles[] = {
+    "test_1", "test_2", "test_3", "test_5", "test_7", "test_8", "test_9", "test_10", "test_11",
+    "test_12", "test_13", "test_14", "test_15", "test_16", "test_17", "test_18", "test_19", "test_22"
+};
+
+int main(int argc, char **argv)
+{
+    int failures = 0;
+
+    if (argc < 2)
+    {
+        printf("usage: %s <reference folder>\n", argv[0]);
+        return 1;
+    }
+
+    for (int f = 0; f < (int)(sizeof(xmFiles) / sizeof(xmFiles[0])); f++)
+    {
+        char fileName[512], referenceName[512];
+        snprintf(fileName, sizeof(fileName), "../res/common/assets/%s.xm", xmFiles[f]);
+        snprintf(referenceName, sizeof(referenceName), "%s/%s.f32", argv[1], xmFiles[f]);
+
+        Wave wave = RenderMusicWave(fileName, XM_SAMPLE_RATE, XM_SECONDS, 0);
+        if (wave.data == NULL)
+        {
+            printf("xm_fixed_point: failed to render %s\n", fileName);
+            return 1;
+        }
+
+#if !JAR_XM_FIXED_POINT
+        FILE *file = fopen(referenceName, "wb");
+        if ((file == NULL) || (fwrite(wave.data, sizeof(float), wave.sampleCount, file) != wave.sampleCount))
+        {
+            printf("xm_fixed_point: failed to write %s\n", referenceName);
+            return 1;
+        }
+        fclose(file);
+#else
+        float *reference = (float *)RL_MALLOC(wave.sampleCount * sizeof(float));
+        FILE *file = fopen(referenceName, "rb");
+        if ((file == NULL) || (fread(reference, sizeof(float), wave.sampleCount, file) != wave.sampleCount))
+        {
+            printf("xm_fixed_point: no reference render %s, run the float build first\n", referenceName);
+            return 1;
+        }
+        fclose(file);
+
+        // Error power against music power, over the whole render
+        const float *samples = (const float *)wave.data;
+        double signal = 0.0, error = 0.0, largest = 0.0;
+        for (unsigned int i = 0; i < wave.sampleCount; i++)
+        {
+            double difference = (double)samples[i] - (double)reference[i];
+            signal += (double)reference[i] * reference[i];
+            error += difference * difference;
+            if (fabs(difference) > largest)
+                largest = fabs(difference);
+        }
+
+        double snr = (error > 0.0) ? 10.0 * log10(signal / error) : 999.0;
+        bool passed = snr >= XM_TOLERANCE_DB;
+        printf("xm_fixed_point: %-8s %6.1f dB, largest difference %.2e%s\n", xmFiles[f], snr, largest, passed ? "" : "  FAILED");
+        failures += !passed;
+
+        RL_FREE(reference);
+        remove(referenceName);
+#endif
+        UnloadWave(wave);
+    }
+
+    return (failures == 0) ? 0 : 1;
+}